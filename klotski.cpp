@@ -22,34 +22,71 @@
 #include <iomanip>
 #include <stdexcept>
 #include <getopt.h>
+#include "klotski_arena.h"
 #include "klotski_board.h"
+#include "klotski_checkpoint.h"
+#include "klotski_corpus.h"
+#include "klotski_distributed.h"
 #include "klotski_search.h"
+#include "klotski_terminal.h"
 
 void print_help(){
 	std::cout<<"usage:"<<std::endl
-		<<"   klotski [-x N] [-y N] [-p] [-u N] [-e [situation]] [-s] [-q] [-b] [-f file] [-s [-o file]] [-r] [-h]"<<std::endl<<std::endl<<std::left
-		<<std::setw(5)<<" -x"<<std::setw(20)<<" "<<"specify x size of board, default 3"<<std::endl
-		<<std::setw(5)<<" -y"<<std::setw(20)<<" "<<"specify y size of board, default 3"<<std::endl
-		<<std::setw(5)<<" -p,"<<std::setw(20)<<"--play"<<"play klotski, upset board 10 times if -u not specify"<<std::endl
-		<<std::setw(5)<<" -u,"<<std::setw(20)<<"--upset"<<"upset board, default 10"<<std::endl
-		<<std::setw(5)<<" -e,"<<std::setw(20)<<"--edit"<<"edit board with input"<<std::endl
-		<<std::setw(5)<<" -s,"<<std::setw(20)<<"--search"<<"search answer"<<std::endl
-		<<std::setw(5)<<" -q,"<<std::setw(20)<<"--quiet"<<"quiet mode"<<std::endl
-		<<std::setw(5)<<" -b,"<<std::setw(20)<<"--board"<<"print situation with board"<<std::endl
-		<<std::setw(5)<<" -o,"<<std::setw(20)<<"--output"<<"output search answer to file"<<std::endl
-		<<std::setw(5)<<" -f,"<<std::setw(20)<<"--file"<<"init board from file"<<std::endl
-		<<std::setw(5)<<" -r,"<<std::setw(20)<<"--research"<<"same as --play but not check win"<<std::endl
-		<<std::setw(5)<<" -h,"<<std::setw(20)<<"--help"<<"display this help"<<std::endl;
+		<<"   klotski [-x N] [-y N] [-p] [-u N] [-e [situation]] [-s] [-q] [-b] [-f file] [-s [-o file]] [-a size] [--no-symmetry] [--engine name] [--deadline ms] [--transposition size] [--perimeter size] [--no-pruning] [--bitstate size] [--checkpoint file [--checkpoint-interval N]] [--resume file] [--profile] [--corpus file] [--convert-corpus file] [--distributed N] [--workers list [--worker-id N]] [-r] [-h]"<<std::endl<<std::endl<<std::left
+		<<std::setw(5)<<" -x"<<std::setw(24)<<" "<<"specify x size of board, default 3"<<std::endl
+		<<std::setw(5)<<" -y"<<std::setw(24)<<" "<<"specify y size of board, default 3"<<std::endl
+		<<std::setw(5)<<" -p,"<<std::setw(24)<<"--play"<<"play klotski, upset board 10 times if -u not specify"<<std::endl
+		<<std::setw(5)<<" -u,"<<std::setw(24)<<"--upset"<<"upset board, default 10"<<std::endl
+		<<std::setw(5)<<" -e,"<<std::setw(24)<<"--edit"<<"edit board with input"<<std::endl
+		<<std::setw(5)<<" -s,"<<std::setw(24)<<"--search"<<"search answer"<<std::endl
+		<<std::setw(5)<<" -q,"<<std::setw(24)<<"--quiet"<<"quiet mode"<<std::endl
+		<<std::setw(5)<<" -b,"<<std::setw(24)<<"--board"<<"print situation with board"<<std::endl
+		<<std::setw(5)<<" -o,"<<std::setw(24)<<"--output"<<"output search answer to file"<<std::endl
+		<<std::setw(5)<<" -f,"<<std::setw(24)<<"--file"<<"init board from file"<<std::endl
+		<<std::setw(5)<<" -a,"<<std::setw(24)<<"--arena size"<<"initial search arena size, K/M/G suffix allowed, default 16M"<<std::endl
+		<<std::setw(5)<<" "<<std::setw(24)<<"--no-symmetry"<<"do not merge mirrored positions on square boards"<<std::endl
+		<<std::setw(5)<<" "<<std::setw(24)<<"--engine name"<<"search engine, bfs, bidirectional, ida or portfolio, default bfs"<<std::endl
+		<<std::setw(5)<<" "<<std::setw(24)<<"--deadline ms"<<"give up after ms milliseconds of racing with --engine portfolio, default none"<<std::endl
+		<<std::setw(5)<<" "<<std::setw(24)<<"--no-pruning"<<"do not prune duplicate move sequences in depth-first searches"<<std::endl
+		<<std::setw(5)<<" "<<std::setw(24)<<"--transposition size"<<"keep bounds of visited positions in a fixed table for --engine ida or portfolio"<<std::endl
+		<<std::setw(5)<<" "<<std::setw(24)<<"--perimeter size"<<"stop bfs and ida searches at a table of the positions near the goal"<<std::endl
+		<<std::setw(5)<<" "<<std::setw(24)<<"--bitstate size"<<"search depth-first with visited positions as bits in a fixed array, may omit a few"<<std::endl
+		<<std::setw(5)<<" "<<std::setw(24)<<"--checkpoint file"<<"save the search to file every --checkpoint-interval seconds"<<std::endl
+		<<std::setw(5)<<" "<<std::setw(24)<<"--checkpoint-interval N"<<"seconds between checkpoints, default 60"<<std::endl
+		<<std::setw(5)<<" "<<std::setw(24)<<"--resume file"<<"continue the search saved in file, checkpointing to it again"<<std::endl
+		<<std::setw(5)<<" "<<std::setw(24)<<"--profile"<<"count cycles, cache and branch misses by search phase, slows the search"<<std::endl
+		<<std::setw(5)<<" "<<std::setw(24)<<"--corpus file"<<"search every board of a binary corpus, one line per board"<<std::endl
+		<<std::setw(5)<<" "<<std::setw(24)<<"--convert-corpus file"<<"write the boards of the -f file to a binary corpus"<<std::endl
+		<<std::setw(5)<<" "<<std::setw(24)<<"--distributed N"<<"search with N local worker processes"<<std::endl
+		<<std::setw(5)<<" "<<std::setw(24)<<"--workers list"<<"worker addresses host:port,..., the first one coordinates"<<std::endl
+		<<std::setw(5)<<" "<<std::setw(24)<<"--worker-id N"<<"index of this process in --workers, default 0"<<std::endl
+		<<std::setw(5)<<" -r,"<<std::setw(24)<<"--research"<<"same as --play but not check win"<<std::endl
+		<<std::setw(5)<<" -h,"<<std::setw(24)<<"--help"<<"display this help"<<std::endl;
 }
 
-void search_answer(std::shared_ptr<klotski_board> board, bool is_quiet, bool is_print_board, std::ostream& os = std::cout){
+// A bitstate search may have dropped the route and the portfolio may have
+// run out of time, so not finding one proves nothing then.
+void print_not_found(const klotski_search_stats& stats, std::ostream& os){
+	if(stats.is_deadline_passed){
+		os<<"deadline passed"<<std::endl;
+	}else if(stats.bitstate_bits != 0){
+		os<<"not found (bitstate search may have omitted it)"<<std::endl;
+	}else{
+		os<<"No solution"<<std::endl;
+	}
+}
+
+void search_answer(std::shared_ptr<klotski_board> board, std::shared_ptr<klotski_arena> arena, const klotski_search_options& options,
+		std::shared_ptr<klotski_distributed> distributed, bool is_quiet, bool is_print_board, std::ostream& os = std::cout){
 	if(board == nullptr){
 		throw std::logic_error("board not init");
 	}
 	if(!is_quiet){
 		board->print_board(is_print_board);
 	}
-	auto s = std::make_shared<klotski_search>(board);
+	auto s = std::make_shared<klotski_search>(board, arena);
+	s->set_options(options);
+	s->set_distributed(distributed);
 	if(!is_quiet){
 		std::cout<<"searching..."<<std::endl;
 	}
@@ -65,8 +102,86 @@ void search_answer(std::shared_ptr<klotski_board> board, bool is_quiet, bool is_
 			klotski_board::print_board(i, board->get_dx(), board->get_dy(), is_print_board, os);
 			os<<std::endl;
 		}
+	}else if(!s->get_last_error().empty()){
+		throw std::runtime_error(s->get_last_error());
 	}else{
-		os<<"No solution"<<std::endl;
+		print_not_found(s->get_last_stats(), os);
+	}
+	if(!is_quiet && distributed != nullptr){
+		std::cout<<"distributed over "<<distributed->get_workers()<<" workers: "
+			<<distributed->get_last_states()<<" states in "<<distributed->get_last_layers()<<" layers"<<std::endl;
+	}else if(!is_quiet && options.engine == PortfolioEngine){
+		const auto& stats = s->get_last_stats();
+		if(stats.portfolio_winner >= 0){
+			std::cout<<"portfolio: "<<klotski_portfolio::get_strategy_name(stats.portfolio_winner)<<" won, "
+				<<stats.portfolio_raced<<" engines raced"<<std::endl;
+		}else if(stats.portfolio_raced != 0){
+			std::cout<<"portfolio: no engine finished, "<<stats.portfolio_raced<<" engines raced"<<std::endl;
+		}
+	}else if(!is_quiet){
+		std::cout<<"arena used "<<klotski_arena::format_size(arena->get_used())
+			<<", peak footprint "<<klotski_arena::format_size(arena->get_peak_footprint())<<std::endl;
+	}
+	const auto& stats = s->get_last_stats();
+	if(!is_quiet && options.engine == IdaEngine && options.bitstate_size == 0 && distributed == nullptr){
+		std::cout<<"ida: "<<stats.states<<" nodes expanded, final bound "<<stats.depth<<std::endl;
+		if(stats.transposition_capacity != 0){
+			std::cout<<"transposition table: "<<stats.transposition_entries<<" of "<<stats.transposition_capacity
+				<<" entries used, "<<stats.transposition_hits<<" hits"<<std::endl;
+		}
+	}
+	if(!is_quiet && stats.perimeter_entries != 0){
+		std::cout<<"perimeter: "<<stats.perimeter_entries<<" entries, every position within "<<stats.perimeter_depth
+			<<" moves of the goal"<<std::endl;
+	}
+	if(!is_quiet && stats.bitstate_bits != 0){
+		std::cout<<"bitstate: "<<stats.states<<" states to depth "<<stats.depth<<", "
+			<<stats.bitstate_set_bits<<" of "<<stats.bitstate_bits<<" bits set, omission probability "
+			<<stats.omission_probability<<", expected omissions "<<stats.expected_omissions<<std::endl;
+	}
+	if(stats.profile.searches != 0){
+		stats.profile.print();
+	}
+}
+
+void search_corpus(const std::string& path, std::shared_ptr<klotski_arena> arena, const klotski_search_options& options,
+		std::shared_ptr<klotski_distributed> distributed, bool is_quiet, std::ostream& os = std::cout){
+	klotski_corpus_reader corpus(path);
+	const int dx = corpus.get_width();
+	const int dy = corpus.get_height();
+	std::uint64_t solved = 0;
+	klotski_profile profile;
+	for(std::uint64_t i=0; i<corpus.get_count(); ++i){
+		klotski_board board(corpus.get_board(i), dx, dy);
+		os<<"board "<<i<<": ";
+		if(!board.is_valid()){
+			os<<"invalid"<<std::endl;
+			continue;
+		}
+		klotski_search s(board, arena);
+		s.set_options(options);
+		s.set_distributed(distributed);
+		if(s.start_search()){
+			os<<s.get_last_route().size() - 1<<" steps"<<std::endl;
+			++solved;
+		}else if(!s.get_last_error().empty()){
+			throw std::runtime_error(s.get_last_error());
+		}else{
+			print_not_found(s.get_last_stats(), os);
+		}
+		if(s.get_last_stats().profile.searches != 0){
+			if(!is_quiet){
+				s.get_last_stats().profile.print();
+			}
+			profile += s.get_last_stats().profile;
+		}
+	}
+	if(!is_quiet){
+		std::cout<<"solved "<<solved<<" of "<<corpus.get_count()<<" "<<dx<<"x"<<dy<<" boards"<<std::endl;
+	}
+	if(profile.searches != 0){
+		std::cout<<"profile of "<<profile.searches<<" searches:"<<std::endl;
+		profile.print();
 	}
 }
 
@@ -96,9 +211,36 @@ int main(int argc, char *argv[])
 	std::fstream situation_output_file;
 	bool is_read_board_from_file = false;
 	std::fstream situation_input_file;
+	std::string situation_input_path;
+	std::string corpus_path;
+	std::string convert_corpus_path;
 	bool is_research = false;
+	size_t arena_size = klotski_arena::default_size;
+	klotski_search_options search_options;
+	int distributed_workers = 0;
+	std::string workers_string;
+	int worker_id = 0;
 
-	const char *optstring = "x:y:pu:e::sqbo:f:rh";
+	enum{
+		OPT_NO_SYMMETRY = 256,
+		OPT_ENGINE,
+		OPT_DEADLINE,
+		OPT_NO_PRUNING,
+		OPT_TRANSPOSITION,
+		OPT_PERIMETER,
+		OPT_BITSTATE,
+		OPT_CHECKPOINT,
+		OPT_CHECKPOINT_INTERVAL,
+		OPT_RESUME,
+		OPT_PROFILE,
+		OPT_CORPUS,
+		OPT_CONVERT_CORPUS,
+		OPT_DISTRIBUTED,
+		OPT_WORKERS,
+		OPT_WORKER_ID
+	};
+
+	const char *optstring = "x:y:pu:e::sqbo:f:a:rh";
 	static struct option long_options[] = {
 		{"play",		no_argument, NULL, 'p'},
 		{"upset",		required_argument, NULL, 'u'},
@@ -108,6 +250,23 @@ int main(int argc, char *argv[])
 		{"board",		no_argument, NULL, 'b'},
 		{"output",		required_argument, NULL, 'o'},
 		{"file",		required_argument, NULL, 'f'},
+		{"arena",		required_argument, NULL, 'a'},
+		{"no-symmetry",	no_argument, NULL, OPT_NO_SYMMETRY},
+		{"engine",		required_argument, NULL, OPT_ENGINE},
+		{"deadline",	required_argument, NULL, OPT_DEADLINE},
+		{"no-pruning",	no_argument, NULL, OPT_NO_PRUNING},
+		{"transposition",	required_argument, NULL, OPT_TRANSPOSITION},
+		{"perimeter",	required_argument, NULL, OPT_PERIMETER},
+		{"bitstate",	required_argument, NULL, OPT_BITSTATE},
+		{"checkpoint",	required_argument, NULL, OPT_CHECKPOINT},
+		{"checkpoint-interval",	required_argument, NULL, OPT_CHECKPOINT_INTERVAL},
+		{"resume",		required_argument, NULL, OPT_RESUME},
+		{"profile",		no_argument, NULL, OPT_PROFILE},
+		{"corpus",		required_argument, NULL, OPT_CORPUS},
+		{"convert-corpus",	required_argument, NULL, OPT_CONVERT_CORPUS},
+		{"distributed",	required_argument, NULL, OPT_DISTRIBUTED},
+		{"workers",		required_argument, NULL, OPT_WORKERS},
+		{"worker-id",	required_argument, NULL, OPT_WORKER_ID},
 		{"research",	no_argument, NULL, 'r'},
 		{"help",		no_argument, NULL, 'h'},
 		{0, 0, 0, 0}};
@@ -180,6 +339,7 @@ int main(int argc, char *argv[])
 
 			case 'f':
 				is_read_board_from_file = true;
+				situation_input_path = optarg;
 				situation_input_file.open(optarg, ios::in);
 				if(!situation_input_file.is_open()){
 					cout<<"file not found"<<endl;
@@ -187,10 +347,136 @@ int main(int argc, char *argv[])
 				}
 				break;
 
+			case 'a':
+				try{
+					arena_size = klotski_arena::parse_size(optarg);
+				}catch(const std::invalid_argument&){
+					cout<<"Invalid argument: arena size"<<endl;
+					return EXIT_FAILURE;
+				}
+				break;
+
 			case 'r':
 				is_research = true;
 				break;
 
+			case OPT_NO_SYMMETRY:
+				search_options.use_symmetry = false;
+				break;
+
+			case OPT_ENGINE:
+				if(std::string(optarg) == "bfs"){
+					search_options.engine = BfsEngine;
+				}else if(std::string(optarg) == "ida"){
+					search_options.engine = IdaEngine;
+				}else if(std::string(optarg) == "bidirectional"){
+					search_options.engine = BidirectionalEngine;
+				}else if(std::string(optarg) == "portfolio"){
+					search_options.engine = PortfolioEngine;
+				}else{
+					cout<<"Invalid argument: engine"<<endl;
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case OPT_DEADLINE:
+				try{
+					search_options.portfolio_deadline = std::stoi(optarg);
+					if(search_options.portfolio_deadline <= 0){
+						throw std::invalid_argument(optarg);
+					}
+				}catch(const std::invalid_argument&){
+					cout<<"Invalid argument: deadline"<<endl;
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case OPT_NO_PRUNING:
+				search_options.use_move_pruning = false;
+				break;
+
+			case OPT_TRANSPOSITION:
+				try{
+					search_options.transposition_size = klotski_arena::parse_size(optarg);
+				}catch(const std::invalid_argument&){
+					cout<<"Invalid argument: transposition size"<<endl;
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case OPT_PERIMETER:
+				try{
+					search_options.perimeter_size = klotski_arena::parse_size(optarg);
+				}catch(const std::invalid_argument&){
+					cout<<"Invalid argument: perimeter size"<<endl;
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case OPT_BITSTATE:
+				try{
+					search_options.bitstate_size = klotski_arena::parse_size(optarg);
+				}catch(const std::invalid_argument&){
+					cout<<"Invalid argument: bitstate size"<<endl;
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case OPT_CHECKPOINT:
+				search_options.checkpoint_path = optarg;
+				break;
+
+			case OPT_CHECKPOINT_INTERVAL:
+				try{
+					search_options.checkpoint_interval = std::stoi(optarg);
+					if(search_options.checkpoint_interval <= 0){
+						throw std::invalid_argument(optarg);
+					}
+				}catch(const std::invalid_argument&){
+					cout<<"Invalid argument: checkpoint interval"<<endl;
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case OPT_RESUME:
+				search_options.resume_path = optarg;
+				is_search = true;
+				break;
+
+			case OPT_PROFILE:
+				search_options.use_profiling = true;
+				break;
+
+			case OPT_CORPUS:
+				corpus_path = optarg;
+				break;
+
+			case OPT_CONVERT_CORPUS:
+				convert_corpus_path = optarg;
+				break;
+
+			case OPT_DISTRIBUTED:
+				try{
+					distributed_workers = std::stoi(optarg);
+				}catch(const std::invalid_argument&){
+					cout<<"Invalid argument: distributed"<<endl;
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case OPT_WORKERS:
+				workers_string = optarg;
+				break;
+
+			case OPT_WORKER_ID:
+				try{
+					worker_id = std::stoi(optarg);
+				}catch(const std::invalid_argument&){
+					cout<<"Invalid argument: worker id"<<endl;
+					return EXIT_FAILURE;
+				}
+				break;
+
 			case '?':
 			case 'h':
 			default:
@@ -200,12 +486,122 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	if(is_output_to_file && !is_search){
+	if(is_output_to_file && !is_search && corpus_path.empty()){
 		cout<<"specifying -o must also specify -s"<<endl;
 		return EXIT_FAILURE;
 	}
 
+	if(search_options.transposition_size != 0 && search_options.engine != IdaEngine
+			&& search_options.engine != PortfolioEngine){
+		cout<<"specifying --transposition must also specify --engine ida or portfolio"<<endl;
+		return EXIT_FAILURE;
+	}
+
+	if(search_options.portfolio_deadline != 0 && search_options.engine != PortfolioEngine){
+		cout<<"specifying --deadline must also specify --engine portfolio"<<endl;
+		return EXIT_FAILURE;
+	}
+
+	if(search_options.engine == PortfolioEngine && (search_options.bitstate_size != 0
+			|| !search_options.checkpoint_path.empty() || !search_options.resume_path.empty())){
+		cout<<"specifying --engine portfolio can't also specify --bitstate, --checkpoint or --resume"<<endl;
+		return EXIT_FAILURE;
+	}
+
+	// Only the breadth-first engine keeps a state to save.
+	if((!search_options.checkpoint_path.empty() || !search_options.resume_path.empty())
+			&& (search_options.engine == IdaEngine || search_options.engine == BidirectionalEngine
+			|| distributed_workers > 1 || !workers_string.empty())){
+		cout<<"specifying --checkpoint or --resume can't also specify --engine ida or bidirectional, --distributed or --workers"<<endl;
+		return EXIT_FAILURE;
+	}
+
+	// The bitstate search is an engine of its own.
+	if(search_options.bitstate_size != 0 && (search_options.engine == IdaEngine || search_options.engine == BidirectionalEngine
+			|| !search_options.checkpoint_path.empty() || !search_options.resume_path.empty() || search_options.perimeter_size != 0
+			|| distributed_workers > 1 || !workers_string.empty())){
+		cout<<"specifying --bitstate can't also specify --engine ida or bidirectional, --checkpoint, --resume, --perimeter, --distributed or --workers"<<endl;
+		return EXIT_FAILURE;
+	}
+
+	// The profiler counts the calling thread, and the portfolio and the
+	// workers search on threads and processes of their own.
+	if(search_options.use_profiling && (search_options.engine == PortfolioEngine
+			|| distributed_workers > 1 || !workers_string.empty())){
+		cout<<"specifying --profile can't also specify --engine portfolio, --distributed or --workers"<<endl;
+		return EXIT_FAILURE;
+	}
+
+	if(!convert_corpus_path.empty()){
+		if(!is_read_board_from_file){
+			cout<<"specifying --convert-corpus must also specify -f"<<endl;
+			return EXIT_FAILURE;
+		}
+		try{
+			const auto count = klotski_convert_corpus(situation_input_path, convert_corpus_path, dx, dy);
+			if(!is_quiet){
+				cout<<"wrote "<<count<<" "<<dx<<"x"<<dy<<" boards to "<<convert_corpus_path<<endl;
+			}
+		}catch(const std::exception& e){
+			cout<<e.what()<<endl;
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
 	std::shared_ptr<klotski_board> board = nullptr;
+	auto arena = std::make_shared<klotski_arena>(arena_size);
+
+	if(!search_options.resume_path.empty()){
+		if(is_read_board_from_file || is_edit || is_upset){
+			cout<<"specifying --resume can't also specify -f, -e or -u"<<endl;
+			return EXIT_FAILURE;
+		}
+		try{
+			klotski_checkpoint_reader reader(search_options.resume_path);
+			const auto& header = reader.get_header();
+			dx = header.width;
+			dy = header.height;
+			board = std::make_shared<klotski_board>(std::vector<int>(header.root.begin(), header.root.end()), dx, dy);
+			search_options.use_symmetry = header.use_symmetry;
+			if(search_options.checkpoint_path.empty()){
+				search_options.checkpoint_path = search_options.resume_path;
+			}
+			if(!is_quiet){
+				cout<<"resuming "<<header.records<<" states, "<<header.expanded<<" expanded"<<endl;
+			}
+		}catch(const std::runtime_error& e){
+			cout<<e.what()<<endl;
+			return EXIT_FAILURE;
+		}
+	}
+	std::shared_ptr<klotski_distributed> distributed = nullptr;
+
+	try{
+		if(!workers_string.empty()){
+			auto endpoints = klotski_distributed::parse_endpoints(workers_string);
+			if(worker_id != 0){
+				klotski_distributed(endpoints, worker_id).serve();
+				return EXIT_SUCCESS;
+			}
+			distributed = std::make_shared<klotski_distributed>(endpoints, worker_id);
+		}else if(distributed_workers > 1){
+			distributed = klotski_distributed::launch_local(distributed_workers);
+		}
+	}catch(const std::exception& e){
+		cout<<e.what()<<endl;
+		return EXIT_FAILURE;
+	}
+
+	if(!corpus_path.empty()){
+		try{
+			search_corpus(corpus_path, arena, search_options, distributed, is_quiet, KLOTSKI_OUTPUT_STREAM);
+		}catch(const std::runtime_error& e){
+			cout<<e.what()<<endl;
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
 
 	if(is_read_board_from_file){
 		if(is_edit){
@@ -257,7 +653,13 @@ int main(int argc, char *argv[])
 		if(board == nullptr){
 			board = std::make_shared<klotski_board>(dx, dy);
 		}
-		search_answer(board, is_quiet, is_print_board, KLOTSKI_OUTPUT_STREAM);
+		try{
+			search_answer(board, arena, search_options, distributed, is_quiet, is_print_board, KLOTSKI_OUTPUT_STREAM);
+		}catch(const std::runtime_error& e){
+			cout<<e.what()<<endl;
+			return EXIT_FAILURE;
+		}
+		search_options.resume_path.clear();
 	}
 
 	if(is_play || is_research){
@@ -269,7 +671,8 @@ int main(int argc, char *argv[])
 			board->upset(upset_num);
 			is_already_upset = true;
 		}
-		board->print_board(is_print_board);
+		klotski_terminal terminal;
+		terminal.draw(*board, is_print_board);
 		string line;
 		string hint = "klotski>";
 		while(is_research || !board->is_win()){
@@ -281,7 +684,7 @@ int main(int argc, char *argv[])
 			std::stringstream ss(line);
 			ss>>x>>y;
 			if(board->move_item(x, y)){
-				board->print_board(is_print_board);
+				terminal.draw(*board, is_print_board);
 				continue;
 			}
 			line = line.substr(0, line.find_last_not_of(' ')+1);
@@ -293,24 +696,32 @@ int main(int argc, char *argv[])
 			}else if(cmd_name == "reset" || cmd_name == "r"){
 				board->reset();
 				if(!is_quiet){
-					board->print_board(is_print_board);
+					terminal.draw(*board, is_print_board);
 				}
 			}else if(cmd_name == "print" || cmd_name == "p"){
-				board->print_board(is_print_board);
+				terminal.invalidate();
+				terminal.draw(*board, is_print_board);
 			}else if(cmd_name == "search" || cmd_name == "s"){
-				search_answer(board, is_quiet, is_print_board, KLOTSKI_OUTPUT_STREAM);
+				try{
+					search_answer(board, arena, search_options, distributed, is_quiet, is_print_board, KLOTSKI_OUTPUT_STREAM);
+				}catch(const std::runtime_error& e){
+					cout<<e.what()<<endl;
+				}
+				terminal.invalidate();
 			}else if(cmd_name == "upset" || cmd_name == "u"){
 				try{
 					board->upset(std::stoi(cmd_arg));
 					if(!is_quiet){
-						board->print_board(is_print_board);
+						terminal.draw(*board, is_print_board);
 					}
 				}catch(const std::invalid_argument&){
 					cout<<"invalid argument"<<endl
 						<<"usage: upset N"<<endl<<endl;
+					terminal.invalidate();
 				}
 			}else{
 				system(line.c_str());
+				terminal.invalidate();
 			}
 		}
 		cout<<"You Win!"<<endl;
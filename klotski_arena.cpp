@@ -0,0 +1,95 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#include "klotski_arena.h"
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+klotski_arena::klotski_arena(std::size_t initial_size):
+	initial_size(initial_size),
+	buffer(initial_size != 0? new std::byte[initial_size]: nullptr),
+	upstream(std::pmr::new_delete_resource(), true),
+	pool(buffer.get(), initial_size, &upstream),
+	front(&pool, false){
+	}
+
+void klotski_arena::reset() noexcept{
+	pool.release();
+	front.clear();
+}
+
+std::size_t klotski_arena::parse_size(const std::string& size_string){
+	std::size_t pos = 0;
+	unsigned long long size;
+	// stoull takes a sign or leading blanks, and a negative size wraps around.
+	if(size_string.empty() || !std::isdigit(static_cast<unsigned char>(size_string[0]))){
+		throw std::invalid_argument("invalid size: " + size_string);
+	}
+	try{
+		size = std::stoull(size_string, &pos);
+	}catch(const std::logic_error&){
+		throw std::invalid_argument("invalid size: " + size_string);
+	}
+	int shift = 0;
+	if(pos < size_string.size()){
+		switch(std::toupper(static_cast<unsigned char>(size_string[pos++]))){
+			case 'K': shift = 10; break;
+			case 'M': shift = 20; break;
+			case 'G': shift = 30; break;
+			default:
+				throw std::invalid_argument("invalid size: " + size_string);
+		}
+	}
+	if(pos != size_string.size()
+			|| size > (std::numeric_limits<std::size_t>::max() >> shift)){
+		throw std::invalid_argument("invalid size: " + size_string);
+	}
+	return static_cast<std::size_t>(size) << shift;
+}
+
+std::string klotski_arena::format_size(std::size_t size){
+	const char* units[] = {"B", "KiB", "MiB", "GiB"};
+	double value = static_cast<double>(size);
+	int unit = 0;
+	while(value >= 1024 && unit < 3){
+		value /= 1024;
+		++unit;
+	}
+	std::stringstream ss;
+	ss.precision(unit == 0? 0: 1);
+	ss<<std::fixed<<value<<" "<<units[unit];
+	return ss.str();
+}
+
+void* klotski_arena::counting_resource::do_allocate(std::size_t bytes, std::size_t alignment){
+	void* p = next->allocate(bytes, alignment);
+	current += bytes;
+	peak = std::max(peak, current);
+	return p;
+}
+
+void klotski_arena::counting_resource::do_deallocate(void* p, std::size_t bytes, std::size_t alignment){
+	next->deallocate(p, bytes, alignment);
+	if(track_release){
+		current -= bytes;
+	}
+}
+
+bool klotski_arena::counting_resource::do_is_equal(const std::pmr::memory_resource& other) const noexcept{
+	return this == &other;
+}
@@ -0,0 +1,100 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#ifndef KLOTSKI_ARENA_H
+#define KLOTSKI_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <string>
+
+// Per-search memory pool. Everything a search allocates comes from one
+// monotonic buffer that is dropped in one go by reset(), so the same arena
+// can be handed to every search of a session.
+class klotski_arena
+{
+	public:
+		static constexpr std::size_t default_size = 16 * 1024 * 1024;
+
+		explicit klotski_arena(std::size_t initial_size = default_size);
+		klotski_arena(const klotski_arena&) = delete;
+		klotski_arena& operator=(const klotski_arena&) = delete;
+
+		std::pmr::memory_resource* get_resource() noexcept{
+			return &front;
+		}
+
+		void reset() noexcept;
+
+		std::size_t get_initial_size() const noexcept{
+			return initial_size;
+		}
+
+		std::size_t get_used() const noexcept{
+			return front.get_current();
+		}
+
+		std::size_t get_footprint() const noexcept{
+			return initial_size + upstream.get_current();
+		}
+
+		std::size_t get_peak_used() const noexcept{
+			return front.get_peak();
+		}
+
+		std::size_t get_peak_footprint() const noexcept{
+			return initial_size + upstream.get_peak();
+		}
+
+		static std::size_t parse_size(const std::string& size_string);
+		static std::string format_size(std::size_t size);
+
+	private:
+		class counting_resource: public std::pmr::memory_resource{
+			public:
+				counting_resource(std::pmr::memory_resource* next, bool track_release) noexcept:
+					next(next), track_release(track_release){}
+
+				std::size_t get_current() const noexcept{
+					return current;
+				}
+
+				std::size_t get_peak() const noexcept{
+					return peak;
+				}
+
+				void clear() noexcept{
+					current = 0;
+				}
+
+			private:
+				void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+				void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override;
+				bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+				std::pmr::memory_resource* next;
+				bool track_release;
+				std::size_t current = 0;
+				std::size_t peak = 0;
+		};
+
+		std::size_t initial_size;
+		std::unique_ptr<std::byte[]> buffer;
+		counting_resource upstream;
+		std::pmr::monotonic_buffer_resource pool;
+		counting_resource front;
+};
+
+#endif
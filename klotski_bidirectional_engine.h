@@ -0,0 +1,245 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#ifndef KLOTSKI_BIDIRECTIONAL_ENGINE_H
+#define KLOTSKI_BIDIRECTIONAL_ENGINE_H
+
+#include "klotski_search_engine.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory_resource>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Breadth-first search from the start and from the goal at once, always
+// growing the smaller frontier by a whole layer. The first layer that
+// touches the other side holds every shortest meeting, so the best one in
+// it is an optimal route. Each side only goes about half as deep as a
+// plain breadth-first search.
+template<typename Geometry>
+class klotski_bidirectional_engine: public klotski_search_engine{
+	public:
+		using cell_type = typename Geometry::cell_type;
+
+		explicit klotski_bidirectional_engine(Geometry geometry = Geometry(), const klotski_search_options& = klotski_search_options()):
+			geometry(std::move(geometry)){}
+
+		using klotski_search_engine::search;
+		bool search(const std::uint16_t* cells, klotski_arena& arena, route_type& route) override;
+
+	private:
+		struct record_item{
+			const record_item* prev;
+			klotski_search_state<Geometry> state;
+			std::uint8_t direction;
+			std::uint32_t depth;
+
+			cell_type* cells() noexcept{
+				return reinterpret_cast<cell_type*>(this + 1);
+			}
+
+			const cell_type* cells() const noexcept{
+				return reinterpret_cast<const cell_type*>(this + 1);
+			}
+		};
+
+		class record_hash{
+			public:
+				size_t operator()(const record_item* item) const noexcept{
+					return static_cast<size_t>(item->state.hash);
+				}
+		};
+
+		class record_equal{
+			public:
+				explicit record_equal(const Geometry& geometry) noexcept: geometry(&geometry){}
+				bool operator()(const record_item* a, const record_item* b) const noexcept{
+					return a->state.hash == b->state.hash
+						&& std::memcmp(a->cells(), b->cells(), geometry->get_size() * sizeof(cell_type)) == 0;
+				}
+			private:
+				const Geometry* geometry;
+		};
+
+		using record_set = std::pmr::unordered_set<const record_item*, record_hash, record_equal>;
+		using layer_type = std::pmr::vector<const record_item*>;
+
+		struct side{
+			record_set visited;
+			layer_type layer;
+			layer_type next;
+
+			side(const Geometry& geometry, std::pmr::memory_resource* resource):
+				visited(1024, record_hash(), record_equal(geometry), resource),
+				layer(resource),
+				next(resource){}
+		};
+
+		// Grows this side by one layer and keeps the shortest meeting with
+		// other in meet; false when cancelled.
+		bool expand(side& self, const side& other, std::pmr::memory_resource* resource,
+				std::pair<const record_item*, const record_item*>& meet);
+		record_item* new_record(std::pmr::memory_resource* resource) const;
+		void build_route(const record_item& forward, const record_item& backward, route_type& route) const;
+
+		Geometry geometry;
+};
+
+template<typename Geometry>
+bool klotski_bidirectional_engine<Geometry>::search(const std::uint16_t* root_cells, klotski_arena& arena, route_type& route){
+	const int n = geometry.get_size();
+	auto* resource = arena.get_resource();
+	side forward(geometry, resource);
+	side backward(geometry, resource);
+
+	auto* root = new_record(resource);
+	root->prev = nullptr;
+	root->direction = DirectionCount;
+	root->depth = 0;
+	std::copy(root_cells, root_cells + n, root->cells());
+	root->state.init(geometry, root->cells());
+	auto* goal = new_record(resource);
+	goal->prev = nullptr;
+	goal->direction = DirectionCount;
+	goal->depth = 0;
+	for(int pos=0; pos<n; ++pos){
+		goal->cells()[pos] = static_cast<cell_type>(pos + 1 == n? 0: pos + 1);
+	}
+	goal->state.init(geometry, goal->cells());
+	if(root->state.heuristic == 0){
+		profile(RoutePhase);
+		build_route(*root, *goal, route);
+		return true;
+	}
+	forward.visited.insert(root);
+	forward.layer.push_back(root);
+	backward.visited.insert(goal);
+	backward.layer.push_back(goal);
+
+	std::pair<const record_item*, const record_item*> meet(nullptr, nullptr);
+	while(meet.first == nullptr && !forward.layer.empty() && !backward.layer.empty()){
+		bool is_expanded;
+		if(forward.layer.size() <= backward.layer.size()){
+			is_expanded = expand(forward, backward, resource, meet);
+		}else{
+			is_expanded = expand(backward, forward, resource, meet);
+			std::swap(meet.first, meet.second);
+		}
+		if(!is_expanded){
+			return false;
+		}
+	}
+	stats.states = forward.visited.size() + backward.visited.size();
+	if(meet.first == nullptr){
+		return false;
+	}
+	stats.depth = static_cast<int>(meet.first->depth + meet.second->depth);
+	profile(RoutePhase);
+	build_route(*meet.first, *meet.second, route);
+	return true;
+}
+
+template<typename Geometry>
+bool klotski_bidirectional_engine<Geometry>::expand(side& self, const side& other, std::pmr::memory_resource* resource,
+		std::pair<const record_item*, const record_item*>& meet){
+	const int n = geometry.get_size();
+	std::uint32_t best = std::numeric_limits<std::uint32_t>::max();
+	record_item* spare = nullptr;
+	self.next.clear();
+	for(const record_item* item: self.layer){
+		if(is_cancelled()){
+			return false;
+		}
+		const int zero = item->state.zero;
+		int targets[DirectionCount];
+		int moves[DirectionCount];
+		int count = 0;
+		for(int direction=0; direction<DirectionCount; ++direction){
+			const int target = geometry.neighbor(zero, direction);
+			if(target >= 0 && (item->direction == DirectionCount || direction != (item->direction ^ 1))){
+				targets[count] = target;
+				moves[count++] = direction;
+			}
+		}
+		profile(HeuristicPhase);
+		std::uint32_t heuristics[DirectionCount];
+		item->state.score_moves(geometry, item->cells(), targets, count, heuristics);
+		for(int move=0; move<count; ++move){
+			profile(SuccessorPhase);
+			const int target = targets[move];
+			const int direction = moves[move];
+			if(spare == nullptr){
+				spare = new_record(resource);
+			}
+			const cell_type tile = item->cells()[target];
+			spare->state = item->state;
+			spare->state.heuristic = heuristics[move];
+			spare->state.slide(geometry, target, tile);
+			cell_type* cells = spare->cells();
+			std::memcpy(cells, item->cells(), n * sizeof(cell_type));
+			cells[zero] = tile;
+			cells[target] = 0;
+			profile(VisitedPhase);
+			const bool is_new = self.visited.insert(spare).second;
+			const auto other_item = is_new? other.visited.find(spare): other.visited.end();
+			profile(OtherPhase);
+			if(!is_new){
+				continue;
+			}
+			spare->prev = item;
+			spare->direction = static_cast<std::uint8_t>(direction);
+			spare->depth = item->depth + 1;
+			self.next.push_back(spare);
+			if(other_item != other.visited.end() && spare->depth + (*other_item)->depth < best){
+				best = spare->depth + (*other_item)->depth;
+				meet = std::make_pair(spare, *other_item);
+			}
+			spare = nullptr;
+		}
+	}
+	if(spare != nullptr){
+		resource->deallocate(spare, sizeof(record_item) + n * sizeof(cell_type), alignof(record_item));
+	}
+	std::swap(self.layer, self.next);
+	return true;
+}
+
+template<typename Geometry>
+typename klotski_bidirectional_engine<Geometry>::record_item* klotski_bidirectional_engine<Geometry>::new_record(std::pmr::memory_resource* resource) const{
+	void* memory = resource->allocate(
+			sizeof(record_item) + geometry.get_size() * sizeof(cell_type), alignof(record_item));
+	return new (memory) record_item;
+}
+
+// Forward and backward hold the same position; the moves up to it come from
+// the start side and the ones after it are the goal side's moves undone.
+template<typename Geometry>
+void klotski_bidirectional_engine<Geometry>::build_route(const record_item& forward, const record_item& backward, route_type& route) const{
+	std::vector<std::uint8_t> directions;
+	const record_item* item = &forward;
+	for(; item->prev != nullptr; item = item->prev){
+		directions.push_back(item->direction);
+	}
+	const cell_type* root = item->cells();
+	std::reverse(directions.begin(), directions.end());
+	for(item = &backward; item->prev != nullptr; item = item->prev){
+		directions.push_back(static_cast<std::uint8_t>(item->direction ^ 1));
+	}
+	klotski_build_route(geometry, root, directions, route);
+}
+
+#endif
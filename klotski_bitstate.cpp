@@ -0,0 +1,67 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#include "klotski_bitstate.h"
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+klotski_bitstate::klotski_bitstate(std::size_t size, std::pmr::memory_resource* resource):
+	size(size / sizeof(std::uint64_t) * sizeof(std::uint64_t)),
+	resource(resource){
+		if(this->size == 0){
+			throw std::invalid_argument("bitstate size too small");
+		}
+		words = static_cast<std::uint64_t*>(resource->allocate(this->size, alignof(std::uint64_t)));
+		std::memset(words, 0, this->size);
+		bits = static_cast<std::uint64_t>(this->size) * 8;
+	}
+
+klotski_bitstate::~klotski_bitstate(){
+	resource->deallocate(words, size, alignof(std::uint64_t));
+}
+
+void klotski_bitstate::clear() noexcept{
+	std::memset(words, 0, size);
+	set_bits = 0;
+}
+
+bool klotski_bitstate::test_and_set(std::uint64_t hash) noexcept{
+	const double omission = get_omission_probability();
+	// Double hashing: the k bit indices are h1 + i * h2, h2 being a remix
+	// of the Zobrist hash, reduced to the array by a multiply-shift.
+	std::uint64_t h2 = (hash ^ (hash >> 31)) * 0x94d049bb133111ebull;
+	h2 = (h2 ^ (h2 >> 29)) | 1;
+	bool is_set = true;
+	for(int i=0; i<hash_count; ++i){
+		const std::uint64_t index = static_cast<std::uint64_t>(
+				(static_cast<unsigned __int128>(hash + i * h2) * bits) >> 64);
+		const std::uint64_t mask = std::uint64_t(1) << (index & 63);
+		std::uint64_t& word = words[index >> 6];
+		if((word & mask) == 0){
+			word |= mask;
+			++set_bits;
+			is_set = false;
+		}
+	}
+	if(!is_set){
+		++states;
+		expected_omissions += omission;
+	}
+	return is_set;
+}
+
+double klotski_bitstate::get_omission_probability() const noexcept{
+	return std::pow(static_cast<double>(set_bits) / static_cast<double>(bits), hash_count);
+}
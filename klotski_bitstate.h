@@ -0,0 +1,74 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#ifndef KLOTSKI_BITSTATE_H
+#define KLOTSKI_BITSTATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+// Holzmann-style bitstate visited set: every position sets a few bits of
+// a fixed-size bit array picked from its hash. Memory never grows, but a
+// new position whose bits happen to be set already is taken for visited
+// and silently omitted.
+class klotski_bitstate
+{
+	public:
+		static constexpr int hash_count = 3;
+
+		klotski_bitstate(std::size_t size, std::pmr::memory_resource* resource);
+		klotski_bitstate(const klotski_bitstate&) = delete;
+		klotski_bitstate& operator=(const klotski_bitstate&) = delete;
+
+		// Empties the array for another pass; the counts of positions and
+		// expected omissions carry on across passes.
+		void clear() noexcept;
+
+		// Sets the bits of hash and tells whether they were all set already.
+		bool test_and_set(std::uint64_t hash) noexcept;
+
+		std::uint64_t get_bits() const noexcept{
+			return bits;
+		}
+
+		std::uint64_t get_set_bits() const noexcept{
+			return set_bits;
+		}
+
+		std::uint64_t get_states() const noexcept{
+			return states;
+		}
+
+		// Chance that the next new position is taken for visited.
+		double get_omission_probability() const noexcept;
+
+		// Sum of that chance over every position stored so far.
+		double get_expected_omissions() const noexcept{
+			return expected_omissions;
+		}
+
+		~klotski_bitstate();
+
+	private:
+		std::uint64_t* words;
+		std::uint64_t bits;
+		std::size_t size;
+		std::pmr::memory_resource* resource;
+		std::uint64_t set_bits = 0;
+		std::uint64_t states = 0;
+		double expected_omissions = 0;
+};
+
+#endif
@@ -0,0 +1,176 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#ifndef KLOTSKI_BITSTATE_ENGINE_H
+#define KLOTSKI_BITSTATE_ENGINE_H
+
+#include "klotski_bitstate.h"
+#include "klotski_search_engine.h"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// Iterative-deepening A* over a bitstate visited set, after Holzmann's
+// bitstate depth-first search: memory is the bit array and one path. A
+// position is marked together with its depth and the move that entered it,
+// which fix the search below it, so a later visit along another path is
+// cut; the array is emptied for every bound.
+template<typename Geometry>
+class klotski_bitstate_engine: public klotski_search_engine{
+	public:
+		using cell_type = typename Geometry::cell_type;
+
+		explicit klotski_bitstate_engine(Geometry geometry = Geometry(), const klotski_search_options& options = klotski_search_options()):
+			geometry(std::move(geometry)),
+			use_symmetry(options.use_symmetry && this->geometry.is_square()),
+			bitstate_size(options.bitstate_size){}
+
+		using klotski_search_engine::search;
+		bool search(const std::uint16_t* cells, klotski_arena& arena, route_type& route) override;
+
+	private:
+		static constexpr std::uint32_t unbounded = std::numeric_limits<std::uint32_t>::max();
+
+		// Smallest cost above bound met below state, or the cost of the goal
+		// once is_found is set.
+		std::uint32_t probe(klotski_bitstate& visited, const klotski_search_state<Geometry>& state, std::uint32_t depth,
+				std::uint32_t bound, int last_direction);
+		// A mirrored position is entered by the mirrored move. The move
+		// pruner is left out as the search below a position would then
+		// depend on the path that led there as well.
+		std::uint64_t get_key(const klotski_search_state<Geometry>& state, std::uint32_t depth, int last_direction) const noexcept{
+			std::uint64_t key = state.hash;
+			if(use_symmetry && state.mirror_hash < state.hash){
+				key = state.mirror_hash;
+				last_direction = klotski_mirror_direction(last_direction);
+			}
+			return key ^ 0x9e3779b97f4a7c15ull * (static_cast<std::uint64_t>(depth) * (DirectionCount + 1) + last_direction + 1);
+		}
+		void update_stats(const klotski_bitstate& visited, std::uint32_t bound) noexcept;
+
+		Geometry geometry;
+		bool use_symmetry;
+		std::size_t bitstate_size;
+		std::vector<cell_type> cells;
+		std::vector<std::uint8_t> directions;
+		bool is_found = false;
+};
+
+template<typename Geometry>
+bool klotski_bitstate_engine<Geometry>::search(const std::uint16_t* root_cells, klotski_arena& arena, route_type& route){
+	cells.assign(root_cells, root_cells + geometry.get_size());
+	const std::vector<cell_type> root(cells);
+	klotski_search_state<Geometry> state;
+	state.init(geometry, cells.data());
+	profile(VisitedPhase);
+	klotski_bitstate visited(bitstate_size, arena.get_resource());
+	std::uint32_t bound = state.heuristic;
+	while(true){
+		is_found = false;
+		directions.clear();
+		const std::uint32_t next_bound = probe(visited, state, 0, bound, DirectionCount);
+		update_stats(visited, bound);
+		if(is_found){
+			profile(RoutePhase);
+			klotski_build_route(geometry, root.data(), directions, route);
+			return true;
+		}
+		if(next_bound == unbounded || is_cancelled()){
+			return false;
+		}
+		bound = next_bound;
+		profile(VisitedPhase);
+		visited.clear();
+	}
+}
+
+template<typename Geometry>
+std::uint32_t klotski_bitstate_engine<Geometry>::probe(klotski_bitstate& visited, const klotski_search_state<Geometry>& state,
+		std::uint32_t depth, std::uint32_t bound, int last_direction){
+	if(is_cancelled()){
+		return unbounded;
+	}
+	profile(HeuristicPhase);
+	const std::uint32_t cost = depth + state.heuristic;
+	if(cost > bound){
+		return cost;
+	}
+	if(state.heuristic == 0){
+		is_found = true;
+		return cost;
+	}
+	// What lies below a marked position went into the bound already.
+	profile(VisitedPhase);
+	if(visited.test_and_set(get_key(state, depth, last_direction))){
+		return unbounded;
+	}
+	profile(SuccessorPhase);
+	std::uint32_t next_bound = unbounded;
+	const int zero = state.zero;
+	int targets[DirectionCount];
+	int moves[DirectionCount];
+	int count = 0;
+	for(int direction=0; direction<DirectionCount; ++direction){
+		const int target = geometry.neighbor(zero, direction);
+		if(target < 0 || (last_direction != DirectionCount && direction == (last_direction ^ 1))){
+			continue;
+		}
+		targets[count] = target;
+		moves[count++] = direction;
+	}
+	profile(HeuristicPhase);
+	std::uint32_t heuristics[DirectionCount];
+	state.score_moves(geometry, cells.data(), targets, count, heuristics);
+	for(int move=0; move<count; ++move){
+		const std::uint32_t child_cost = depth + 1 + heuristics[move];
+		if(child_cost > bound){
+			next_bound = std::min(next_bound, child_cost);
+			continue;
+		}
+		profile(SuccessorPhase);
+		const int target = targets[move];
+		const int direction = moves[move];
+		const cell_type tile = cells[target];
+		auto child = state;
+		child.heuristic = heuristics[move];
+		child.slide(geometry, target, tile);
+		cells[zero] = tile;
+		cells[target] = 0;
+		directions.push_back(static_cast<std::uint8_t>(direction));
+		const std::uint32_t child_bound = probe(visited, child, depth + 1, bound, direction);
+		if(is_found){
+			return child_bound;
+		}
+		profile(SuccessorPhase);
+		directions.pop_back();
+		cells[target] = tile;
+		cells[zero] = 0;
+		next_bound = std::min(next_bound, child_bound);
+	}
+	return next_bound;
+}
+
+template<typename Geometry>
+void klotski_bitstate_engine<Geometry>::update_stats(const klotski_bitstate& visited, std::uint32_t bound) noexcept{
+	stats.states = visited.get_states();
+	stats.depth = static_cast<int>(bound);
+	stats.bitstate_bits = visited.get_bits();
+	stats.bitstate_set_bits = visited.get_set_bits();
+	stats.omission_probability = visited.get_omission_probability();
+	stats.expected_omissions = visited.get_expected_omissions();
+}
+
+#endif
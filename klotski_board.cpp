@@ -13,6 +13,8 @@
    limitations under the License.  */
 
 #include "klotski_board.h"
+#include "klotski_geometry.h"
+#include "klotski_simd.h"
 #include <algorithm>
 #include <iostream> 
 #include <fstream>
@@ -25,17 +27,44 @@
 #include <memory>
 #include <stdexcept>
 
+namespace{
+	// Parity of the permutation the tiles make of their goal cells.
+	template<typename T>
+		int get_permutation_parity(const T* cells, int n){
+			std::vector<int> tiles;
+			tiles.reserve(n);
+			for(int i=0; i<n; ++i){
+				if(cells[i] != 0){
+					tiles.push_back(static_cast<int>(cells[i]) - 1);
+				}
+			}
+			const int size = static_cast<int>(tiles.size());
+			std::vector<bool> is_visited(size, false);
+			int cycles = 0;
+			for(int i=0; i<size; ++i){
+				if(is_visited[i]){
+					continue;
+				}
+				++cycles;
+				for(int j=i; !is_visited[j]; j=tiles[j]){
+					is_visited[j] = true;
+				}
+			}
+			return (size - cycles) & 1;
+		}
+}
+
 std::mt19937 klotski_board::random_engine{static_cast<std::mt19937::result_type>(time(nullptr))};
 
 size_t klotski_board::situation_type_hash::operator()(const situation_type& situation) const noexcept{
-	size_t seed = 0;
-	int n = 1;
+	std::uint64_t seed = 0;
+	int pos = 0;
 	for(const auto& i: situation){
 		for(const auto& j: i){
-			seed += j * n++;
+			seed ^= klotski_detail::zobrist_key(pos++, j);
 		}
 	}
-	return seed;
+	return static_cast<size_t>(seed);
 }
 
 klotski_board::klotski_board(std::string situation_string, int dx, int dy, const char split):
@@ -101,6 +130,7 @@ void klotski_board::reset() noexcept{
 	situation[dy - 1][dx - 1] = 0;
 	zero_x = dx - 1;
 	zero_y = dy - 1;
+	is_hash_valid = false;
 }
 
 void klotski_board::upset(int depth) noexcept{
@@ -119,7 +149,7 @@ void klotski_board::print_board(bool display_board, std::ostream& os) const noex
 	return print_board(situation, dx, dy, display_board, os);
 }
 
-void klotski_board::print_board(const situation_type& situation, int dx, int dy, bool display_board, std::ostream& os){
+int klotski_board::get_cell_width(int dx, int dy) noexcept{
 	int space_n = 0;
 	int max_n = dx*dy;
 	while(max_n != 0){
@@ -129,6 +159,11 @@ void klotski_board::print_board(const situation_type& situation, int dx, int dy,
 	if(space_n < 2){
 		space_n = 2;
 	}
+	return space_n;
+}
+
+void klotski_board::print_board(const situation_type& situation, int dx, int dy, bool display_board, std::ostream& os){
+	const int space_n = get_cell_width(dx, dy);
 
 	std::stringstream output_stream;
 	if(display_board){
@@ -171,7 +206,16 @@ bool klotski_board::move_item(int x, int y){
 				move_item(info->is_zero_in_top_or_left?x-1:x+1, y);
 			}
 		}
-		std::swap(situation[y][x], get_zero());
+		int& zero = get_zero();
+		if(is_hash_valid){
+			const int tile = situation[y][x];
+			const int pos = y * dx + x;
+			const int zero_pos = zero_y * dx + zero_x;
+			hash ^= klotski_detail::zobrist_key(pos, tile) ^ klotski_detail::zobrist_key(zero_pos, tile);
+			manhattan += klotski_detail::tile_distance(zero_pos, tile, dx)
+				- klotski_detail::tile_distance(pos, tile, dx);
+		}
+		std::swap(situation[y][x], zero);
 		zero_x = x;
 		zero_y = y;
 		return true;
@@ -180,17 +224,18 @@ bool klotski_board::move_item(int x, int y){
 }
 
 bool klotski_board::is_win() const noexcept{
-	return is_win(situation);
+	// Only the goal has every tile in place.
+	return get_manhattan() == 0;
 }
 
 bool klotski_board::is_win(const situation_type& situation) noexcept{
-	int curr_num=1;
+	int curr_num = 1;
 	for(auto i=situation.cbegin(); i != situation.cend(); ++i){
-		for(auto j = i->cbegin(); j != i->cend(); ++j){
-			if(*j != curr_num++ && !(i+1 == situation.cend() && j+1 == i->cend())){
-				return false;
-			}
+		const int n = static_cast<int>(i->size()) - (i+1 == situation.cend()? 1: 0);
+		if(klotski_simd::mismatch_sequence(i->data(), n, curr_num) != n){
+			return false;
 		}
+		curr_num += n;
 	}
 	return true;
 }
@@ -199,26 +244,7 @@ bool klotski_board::is_valid() const{
 	if(!is_nums_linear()){
 		return false;
 	}
-	std::vector<int> linear_situation;
-	for(const auto& i: situation){
-		for(int j: i){
-			linear_situation.push_back(j);
-		}
-	}
-
-	int rn = 0;
-	int situation_size = linear_situation.size();
-	for (int i = 0; i < situation_size - 1; ++i) {
-		if(linear_situation[i] == 0){
-			continue;
-		}
-		for (int j = i + 1; j < situation_size; ++j) {
-			if(linear_situation[j] != 0
-					&&linear_situation[i] > linear_situation[j]){
-				rn ^= 1;
-			}
-		}
-	}
+	int rn = get_inversion_parity(situation);
 
 	if((dx & 1) == 0){
 		update_zero_pos();
@@ -231,34 +257,13 @@ bool klotski_board::is_valid(const klotski_board::situation_type& situation, int
 	if(!is_nums_linear(situation)){
 		return false;
 	}
-	std::vector<int> linear_situation;
-	for(const auto& i: situation){
-		for(int j: i){
-			linear_situation.push_back(j);
-		}
-	}
-
-	int rn = 0;
-	int situation_size = linear_situation.size();
-	for (int i = 0; i < situation_size - 1; ++i) {
-		if(linear_situation[i] == 0){
-			continue;
-		}
-		for (int j = i + 1; j < situation_size; ++j) {
-			if(linear_situation[j] != 0
-					&&linear_situation[i] > linear_situation[j]){
-				rn ^= 1;
-			}
-		}
-	}
+	int rn = get_inversion_parity(situation);
 
 	if((dx & 1) == 0){
 		int zero_y = -1;
 		for (int i = 0; i < dy; ++i) {
-			for (int j = 0; j < dx; ++j) {
-				if(situation[i][j] == 0){
-					zero_y = i;
-				}
+			if(klotski_simd::find(situation[i].data(), dx, 0) != dx){
+				zero_y = i;
 			}
 		}
 		if(zero_y == -1){
@@ -269,11 +274,32 @@ bool klotski_board::is_valid(const klotski_board::situation_type& situation, int
 	return rn == 0;
 }
 
+bool klotski_board::is_win(const std::uint16_t* cells, int n) noexcept{
+	return cells[n - 1] == 0 && klotski_simd::mismatch_sequence(cells, n - 1, 1) == n - 1;
+}
+
+bool klotski_board::is_valid(const std::uint16_t* cells, int dx, int dy){
+	const int n = dx * dy;
+	std::vector<bool> is_seen(n, false);
+	for(int i=0; i<n; ++i){
+		if(cells[i] >= n || is_seen[cells[i]]){
+			return false;
+		}
+		is_seen[cells[i]] = true;
+	}
+	int rn = get_permutation_parity(cells, n);
+	if((dx & 1) == 0){
+		rn ^= (dy - 1 - klotski_simd::find(cells, n, std::uint16_t(0)) / dx) & 1;
+	}
+	return rn == 0;
+}
+
 const klotski_board::situation_type& klotski_board::get_situation() const noexcept{
 	return situation;
 }
 
 klotski_board::situation_type& klotski_board::get_situation() noexcept{
+	is_hash_valid = false;
 	return const_cast<situation_type&>(
 			static_cast<const klotski_board&>(*this).get_situation()
 			);
@@ -284,26 +310,49 @@ void klotski_board::update_zero_pos() const{
 		return;
 	}
 	for (int i = 0; i < dy; ++i) {
-		for (int j = 0; j < dx; ++j) {
-			if(situation[i][j] == 0){
-				zero_x = j;
-				zero_y = i;
-				return;
-			}
+		const int j = klotski_simd::find(situation[i].data(), dx, 0);
+		if(j != dx){
+			zero_x = j;
+			zero_y = i;
+			return;
 		}
 	}
 	throw std::runtime_error("Can not find zero on klotski board");
 }
 
+std::uint64_t klotski_board::get_hash() const noexcept{
+	update_hash();
+	return hash;
+}
+
+int klotski_board::get_manhattan() const noexcept{
+	update_hash();
+	return manhattan;
+}
+
+void klotski_board::update_hash() const noexcept{
+	if(is_hash_valid){
+		return;
+	}
+	hash = 0;
+	manhattan = 0;
+	for (int i = 0; i < dy; ++i) {
+		for (int j = 0; j < dx; ++j) {
+			hash ^= klotski_detail::zobrist_key(i * dx + j, situation[i][j]);
+		}
+		manhattan += klotski_simd::manhattan(situation[i].data(), dx, dx, i * dx);
+	}
+	is_hash_valid = true;
+}
+
 int& klotski_board::get_zero(){
 	if(situation[zero_y][zero_x] != 0){
 		for(int i=0; i<dy; ++i){
-			for(int j=0; j<dx; ++j){
-				if(situation[i][j] == 0){
-					zero_x = j;
-					zero_y = i;
-					return situation[i][j];
-				}
+			const int j = klotski_simd::find(situation[i].data(), dx, 0);
+			if(j != dx){
+				zero_x = j;
+				zero_y = i;
+				return situation[i][j];
 			}
 		}
 	}else{
@@ -354,23 +403,30 @@ bool klotski_board::is_nums_linear() const noexcept{
 }
 
 bool klotski_board::is_nums_linear(const klotski_board::situation_type& situation) noexcept{
-	std::vector<int> linear_situation;
+	size_t situation_size = 0;
 	for(const auto& i: situation){
-		for(int j: i){
-			linear_situation.push_back(j);
-		}
+		situation_size += i.size();
 	}
-	std::sort(linear_situation.begin(), linear_situation.end());
-	int last_num = -1;
-	for(const auto i: linear_situation){
-		if(last_num != i-1){
-			return false;
+	std::vector<bool> is_seen(situation_size, false);
+	for(const auto& i: situation){
+		for(int j: i){
+			if(j < 0 || static_cast<size_t>(j) >= situation_size || is_seen[j]){
+				return false;
+			}
+			is_seen[j] = true;
 		}
-		last_num = i;
 	}
 	return true;
 }
 
+int klotski_board::get_inversion_parity(const klotski_board::situation_type& situation){
+	std::vector<int> linear_situation;
+	for(const auto& i: situation){
+		linear_situation.insert(linear_situation.end(), i.begin(), i.end());
+	}
+	return get_permutation_parity(linear_situation.data(), static_cast<int>(linear_situation.size()));
+}
+
 void klotski_board::init_board(int n){
 	situation[dy - 1][dx - 1] = n;
 }
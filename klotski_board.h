@@ -17,6 +17,7 @@
 
 #include <iostream> 
 #include <algorithm>
+#include <cstdint>
 #include <ctime>
 #include <random>
 #include <vector>
@@ -41,6 +42,8 @@ class klotski_board
 
 		virtual void print_board(bool display_board = false, std::ostream& os = std::cout) const noexcept;
 		static void print_board(const situation_type& situation, int dx, int dy, bool display_board = false, std::ostream& os = std::cout);
+		// Columns print_board gives every number.
+		static int get_cell_width(int dx, int dy) noexcept;
 
 		bool is_win() const noexcept;
 		static bool is_win(const situation_type& situation) noexcept;
@@ -48,9 +51,19 @@ class klotski_board
 		bool is_valid() const;
 		static bool is_valid(const klotski_board::situation_type& situation, int dx, int dy);
 
+		// The same checks on a position kept as cells row by row, the way the
+		// engines hold it, each one a single kernel pass over the board.
+		static bool is_win(const std::uint16_t* cells, int n) noexcept;
+		static bool is_valid(const std::uint16_t* cells, int dx, int dy);
+
 		const std::vector<std::vector<int>>& get_situation() const noexcept;
 		std::vector<std::vector<int>>& get_situation() noexcept;
 
+		// Zobrist hash and sum of the tiles' Manhattan distances, kept up to
+		// date by move_item.
+		std::uint64_t get_hash() const noexcept;
+		int get_manhattan() const noexcept;
+
 		int get_dx() const noexcept{
 			return dx;
 		}
@@ -62,6 +75,9 @@ class klotski_board
 		class situation_type_hash{
 			public:
 				size_t operator()(const situation_type& situation) const noexcept;
+				size_t operator()(const klotski_board& board) const noexcept{
+					return static_cast<size_t>(board.get_hash());
+				}
 		};
 
 		virtual ~klotski_board() = default;
@@ -78,11 +94,13 @@ class klotski_board
 		};
 
 		void update_zero_pos() const;
+		void update_hash() const noexcept;
 		int& get_zero();
 		std::shared_ptr<pos_info> get_pos_info(int x, int y) const noexcept;
 
 		virtual bool is_nums_linear() const noexcept;
 		static bool is_nums_linear(const klotski_board::situation_type& situation) noexcept;
+		static int get_inversion_parity(const klotski_board::situation_type& situation);
 
 	private:
 		template<typename... Args>
@@ -95,6 +113,9 @@ class klotski_board
 		int dy;
 		mutable int zero_x = 0;
 		mutable int zero_y = 0;
+		mutable std::uint64_t hash = 0;
+		mutable int manhattan = 0;
+		mutable bool is_hash_valid = false;
 		situation_type situation;
 		std::uniform_int_distribution<> x_distribution;
 		std::uniform_int_distribution<> y_distribution;
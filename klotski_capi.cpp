@@ -0,0 +1,292 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#include "klotski_capi.h"
+#include "klotski_arena.h"
+#include "klotski_board.h"
+#include "klotski_geometry.h"
+#include "klotski_search.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads that work through the boards of one batch at a time, each with
+// its own arena so searches never share memory.
+struct klotski_context{
+	klotski_search_options options;
+	std::vector<std::shared_ptr<klotski_arena>> arenas;
+	std::vector<std::thread> threads;
+
+	std::mutex batch_mutex;
+	std::mutex mutex;
+	std::condition_variable work_ready;
+	std::condition_variable work_done;
+	std::function<void(int, std::size_t)> job;
+	std::size_t job_count = 0;
+	std::atomic<std::size_t> job_next{0};
+	std::uint64_t generation = 0;
+	int busy = 0;
+	bool is_stopping = false;
+
+	void work(int thread_index){
+		std::uint64_t seen = 0;
+		std::function<void(int, std::size_t)> batch_job;
+		std::size_t batch_count = 0;
+		for(;;){
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				work_ready.wait(lock, [&]{
+					return is_stopping || generation != seen;
+				});
+				if(is_stopping){
+					return;
+				}
+				seen = generation;
+				// run() may start the next batch while this one is still
+				// being drained, so work from copies taken with the lock held.
+				batch_job = job;
+				batch_count = job_count;
+				++busy;
+			}
+			for(std::size_t i=job_next++; i<batch_count; i=job_next++){
+				batch_job(thread_index, i);
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			if(--busy == 0){
+				work_done.notify_all();
+			}
+		}
+	}
+
+	void run(std::size_t count, std::function<void(int, std::size_t)> batch_job){
+		std::lock_guard<std::mutex> batch_lock(batch_mutex);
+		std::unique_lock<std::mutex> lock(mutex);
+		// A thread that woke late for the last batch may still hold job_next.
+		work_done.wait(lock, [&]{
+			return busy == 0;
+		});
+		job = std::move(batch_job);
+		job_count = count;
+		job_next = 0;
+		++generation;
+		work_ready.notify_all();
+		// Wait until every index is taken and no thread is still on one.
+		work_done.wait(lock, [&]{
+			return busy == 0 && job_next >= job_count;
+		});
+		job = nullptr;
+	}
+};
+
+namespace{
+	// More threads than this is taken for a bad value rather than a request.
+	constexpr unsigned max_threads = 1024;
+	// Tiles are 16-bit, in boards as in the engines.
+	constexpr std::size_t max_cells = 0xffff;
+
+	klotski_search_options make_search_options(const klotski_options& options){
+		klotski_search_options search_options;
+		search_options.engine = options.engine == KLOTSKI_ENGINE_IDA? IdaEngine: BfsEngine;
+		search_options.use_symmetry = options.use_symmetry != 0;
+		search_options.use_move_pruning = options.use_move_pruning != 0;
+		search_options.bitstate_size = static_cast<std::size_t>(options.bitstate_size);
+		search_options.perimeter_size = static_cast<std::size_t>(options.perimeter_size);
+		return search_options;
+	}
+
+	int find_zero(const klotski_board::situation_type& situation, int width){
+		for(std::size_t y=0; y<situation.size(); ++y){
+			for(std::size_t x=0; x<situation[y].size(); ++x){
+				if(situation[y][x] == 0){
+					return static_cast<int>(y) * width + static_cast<int>(x);
+				}
+			}
+		}
+		return -1;
+	}
+
+	// Expands the route, one position per orientation change, to single
+	// moves of the blank; returns how many there are and writes as many as
+	// fit.
+	std::uint32_t write_moves(const std::deque<klotski_board::situation_type>& route, int width,
+			std::uint8_t* moves, std::size_t capacity){
+		std::uint32_t n = 0;
+		int zero = find_zero(route.front(), width);
+		for(std::size_t i=1; i<route.size(); ++i){
+			const int next = find_zero(route[i], width);
+			const int delta_x = next % width - zero % width;
+			const int delta_y = next / width - zero / width;
+			const int direction = delta_x < 0? Left: delta_x > 0? Right: delta_y < 0? Up: Down;
+			for(int k=std::abs(delta_x) + std::abs(delta_y); k>0; --k, ++n){
+				if(n < capacity){
+					moves[n] = static_cast<std::uint8_t>(direction);
+				}
+			}
+			zero = next;
+		}
+		return n;
+	}
+
+	void solve_one(klotski_context& context, int thread_index, int width, int height,
+			const std::uint16_t* cells, std::uint8_t* moves, std::size_t capacity, klotski_result& result){
+		std::memset(&result, 0, sizeof(result));
+		try{
+			if(!klotski_board::is_valid(cells, width, height)){
+				result.status = KLOTSKI_INVALID_BOARD;
+				return;
+			}
+			if(klotski_board::is_win(cells, width * height)){
+				result.status = KLOTSKI_OK;
+				return;
+			}
+			// The engine reads the caller's cells as they are.
+			klotski_arena& arena = *context.arenas[thread_index];
+			arena.reset();
+			auto engine = klotski_search::make_engine(width, height, context.options);
+			klotski_search_engine::route_type route;
+			const bool is_found = engine->search(cells, arena, route);
+			const auto& stats = engine->get_stats();
+			result.states = stats.states;
+			result.depth = static_cast<std::uint32_t>(stats.depth);
+			if(!is_found){
+				result.status = stats.bitstate_bits != 0? KLOTSKI_MAYBE_OMITTED: KLOTSKI_NO_SOLUTION;
+				return;
+			}
+			result.moves = write_moves(route, width, moves, capacity);
+			result.status = result.moves <= capacity? KLOTSKI_OK: KLOTSKI_ROUTE_TOO_LONG;
+		}catch(...){
+			result.status = KLOTSKI_ERROR;
+		}
+	}
+}
+
+extern "C" {
+
+int klotski_abi_version(void){
+	return KLOTSKI_ABI_VERSION;
+}
+
+void klotski_default_options(klotski_options* options){
+	if(options == nullptr){
+		return;
+	}
+	const klotski_search_options defaults;
+	std::memset(options, 0, sizeof(*options));
+	options->struct_size = sizeof(*options);
+	options->engine = defaults.engine == IdaEngine? KLOTSKI_ENGINE_IDA: KLOTSKI_ENGINE_BFS;
+	options->use_symmetry = defaults.use_symmetry? 1: 0;
+	options->use_move_pruning = defaults.use_move_pruning? 1: 0;
+	options->bitstate_size = defaults.bitstate_size;
+	options->arena_size = klotski_arena::default_size;
+	options->perimeter_size = defaults.perimeter_size;
+}
+
+klotski_context* klotski_create(const klotski_options* options){
+	klotski_options settings;
+	klotski_default_options(&settings);
+	if(options != nullptr){
+		// Take only the fields the caller knows about.
+		std::memcpy(&settings, options, std::min<std::size_t>(options->struct_size, sizeof(settings)));
+		settings.struct_size = sizeof(settings);
+	}
+	try{
+		std::unique_ptr<klotski_context> context(new klotski_context);
+		context->options = make_search_options(settings);
+		if(settings.threads > max_threads){
+			return nullptr;
+		}
+		// The bitstate search is an engine of its own.
+		if(settings.bitstate_size != 0 && (settings.engine == KLOTSKI_ENGINE_IDA || settings.perimeter_size != 0)){
+			return nullptr;
+		}
+		int threads = static_cast<int>(settings.threads);
+		if(threads == 0){
+			threads = static_cast<int>(std::min(max_threads, std::max(1u, std::thread::hardware_concurrency())));
+		}
+		const std::size_t arena_size = settings.arena_size != 0? settings.arena_size: klotski_arena::default_size;
+		for(int i=0; i<threads; ++i){
+			context->arenas.push_back(std::make_shared<klotski_arena>(arena_size));
+		}
+		try{
+			for(int i=0; i<threads; ++i){
+				klotski_context* self = context.get();
+				context->threads.emplace_back([self, i]{
+					self->work(i);
+				});
+			}
+		}catch(...){
+			klotski_destroy(context.release());
+			return nullptr;
+		}
+		return context.release();
+	}catch(...){
+		return nullptr;
+	}
+}
+
+void klotski_destroy(klotski_context* context){
+	if(context == nullptr){
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(context->mutex);
+		context->is_stopping = true;
+	}
+	context->work_ready.notify_all();
+	for(auto& thread: context->threads){
+		thread.join();
+	}
+	delete context;
+}
+
+int klotski_solve_batch(klotski_context* context, int width, int height,
+		const uint16_t* boards, size_t count,
+		uint8_t* moves, size_t moves_stride, klotski_result* results){
+	if(context == nullptr || width < 2 || height < 2 || width > 0xffff || height > 0xffff
+			|| static_cast<std::size_t>(width) * height > max_cells
+			|| (count != 0 && (boards == nullptr || results == nullptr))
+			|| (moves == nullptr && moves_stride != 0)){
+		return KLOTSKI_INVALID_ARGUMENT;
+	}
+	const std::size_t cells = static_cast<std::size_t>(width) * height;
+	if(count == 1){
+		std::lock_guard<std::mutex> batch_lock(context->batch_mutex);
+		solve_one(*context, 0, width, height, boards, moves, moves_stride, results[0]);
+		return KLOTSKI_OK;
+	}
+	try{
+		context->run(count, [&](int thread_index, std::size_t i){
+			solve_one(*context, thread_index, width, height, boards + i * cells,
+					moves != nullptr? moves + i * moves_stride: nullptr, moves_stride, results[i]);
+		});
+	}catch(...){
+		return KLOTSKI_ERROR;
+	}
+	return KLOTSKI_OK;
+}
+
+int klotski_solve(klotski_context* context, int width, int height,
+		const uint16_t* board, uint8_t* moves, size_t moves_capacity, klotski_result* result){
+	const int status = klotski_solve_batch(context, width, height, board, 1, moves, moves_capacity, result);
+	return status != KLOTSKI_OK? status: result->status;
+}
+
+}
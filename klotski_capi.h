@@ -0,0 +1,129 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#ifndef KLOTSKI_CAPI_H
+#define KLOTSKI_CAPI_H
+
+/* C interface of libklotski.so. Boards are read from and routes written to
+   buffers the caller owns; nothing returned by the library needs freeing
+   except the context itself. Structures only ever grow at the end, and
+   callers set struct_size so older binaries keep working. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define KLOTSKI_ABI_VERSION 1
+
+/* The library is built with hidden visibility; only these are exported. */
+#if defined(__GNUC__)
+#define KLOTSKI_API __attribute__((visibility("default")))
+#else
+#define KLOTSKI_API
+#endif
+
+/* Direction the blank moves in one step of a route. */
+enum klotski_move{
+	KLOTSKI_MOVE_LEFT = 0,
+	KLOTSKI_MOVE_RIGHT = 1,
+	KLOTSKI_MOVE_UP = 2,
+	KLOTSKI_MOVE_DOWN = 3
+};
+
+enum klotski_status{
+	KLOTSKI_OK = 0,
+	KLOTSKI_NO_SOLUTION = 1,
+	KLOTSKI_INVALID_BOARD = 2,
+	/* The route did not fit; moves holds the length it needs. */
+	KLOTSKI_ROUTE_TOO_LONG = 3,
+	KLOTSKI_INVALID_ARGUMENT = 4,
+	KLOTSKI_ERROR = 5,
+	/* The bitstate search found no route, but may have dropped it. */
+	KLOTSKI_MAYBE_OMITTED = 6
+};
+
+enum klotski_engine{
+	KLOTSKI_ENGINE_BFS = 0,
+	KLOTSKI_ENGINE_IDA = 1
+};
+
+typedef struct klotski_options{
+	uint32_t struct_size;
+	/* Solving threads, 0 for one per CPU, at most 1024. */
+	uint32_t threads;
+	/* One of klotski_engine. */
+	uint32_t engine;
+	/* Merge transposed positions on square boards. */
+	uint32_t use_symmetry;
+	/* Prune duplicate move sequences in depth-first searches. */
+	uint32_t use_move_pruning;
+	uint32_t reserved;
+	/* Bytes of bit array for a bitstate visited set, 0 for the exact one.
+	   It runs a search of its own, so it takes neither KLOTSKI_ENGINE_IDA
+	   nor a perimeter. */
+	uint64_t bitstate_size;
+	/* Initial search arena of every thread, 0 for the default. */
+	uint64_t arena_size;
+	/* Bytes of table for the positions near the goal, built once per board
+	   size and shared by every later search in the process, 0 for none. */
+	uint64_t perimeter_size;
+} klotski_options;
+
+typedef struct klotski_result{
+	/* One of klotski_status. */
+	int32_t status;
+	/* Single moves in the route. */
+	uint32_t moves;
+	/* Positions the search stored or expanded. */
+	uint64_t states;
+	uint32_t depth;
+	uint32_t reserved;
+} klotski_result;
+
+typedef struct klotski_context klotski_context;
+
+KLOTSKI_API int klotski_abi_version(void);
+
+/* Fills options with the defaults of the klotski executable. */
+KLOTSKI_API void klotski_default_options(klotski_options* options);
+
+/* Starts the solving threads; options may be NULL. Returns NULL on
+   failure. */
+KLOTSKI_API klotski_context* klotski_create(const klotski_options* options);
+KLOTSKI_API void klotski_destroy(klotski_context* context);
+
+/* Solves count boards of width x height, at most 65535 cells each, packed
+   back to back in boards as row-major cell numbers with 0 for the blank.
+   The route of board i goes to moves + i * moves_stride as klotski_move
+   values; moves may be NULL when moves_stride is 0 and only results are
+   wanted. results receives count entries. The boards are spread over the solving threads and the call
+   returns when all are done; calls on one context run one at a time.
+   Returns KLOTSKI_OK, or KLOTSKI_INVALID_ARGUMENT without touching
+   results. */
+KLOTSKI_API int klotski_solve_batch(klotski_context* context, int width, int height,
+		const uint16_t* boards, size_t count,
+		uint8_t* moves, size_t moves_stride, klotski_result* results);
+
+/* klotski_solve_batch for a single board; returns its status. */
+KLOTSKI_API int klotski_solve(klotski_context* context, int width, int height,
+		const uint16_t* board, uint8_t* moves, size_t moves_capacity, klotski_result* result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
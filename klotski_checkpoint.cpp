@@ -0,0 +1,182 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#include "klotski_checkpoint.h"
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace{
+	constexpr char magic[8] = {'K', 'L', 'O', 'T', 'S', 'K', 'I', 'C'};
+	constexpr std::uint32_t version = 1;
+	constexpr std::size_t records_offset = 20;
+	constexpr std::size_t fixed_size = 36;
+	constexpr std::size_t entry_size = 5;
+	constexpr std::size_t buffer_size = 1024 * 1024;
+
+	std::uint64_t get_le(const std::uint8_t* in, int bytes) noexcept{
+		std::uint64_t value = 0;
+		for(int i=0; i<bytes; ++i){
+			value |= static_cast<std::uint64_t>(in[i]) << (8 * i);
+		}
+		return value;
+	}
+
+	void put_le(std::uint8_t* out, std::uint64_t value, int bytes) noexcept{
+		for(int i=0; i<bytes; ++i){
+			out[i] = static_cast<std::uint8_t>(value >> (8 * i));
+		}
+	}
+
+	std::size_t get_header_size(const klotski_checkpoint_header& header) noexcept{
+		return fixed_size + header.root.size() * sizeof(std::uint16_t);
+	}
+
+	void write_at(int fd, const std::uint8_t* data, std::size_t size, std::uint64_t offset){
+		while(size != 0){
+			ssize_t n = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+			if(n < 0){
+				throw std::runtime_error("checkpoint: write failed");
+			}
+			data += n;
+			size -= n;
+			offset += n;
+		}
+	}
+
+	// A checkpoint only counts once it is on disk.
+	void sync(int fd){
+		if(::fdatasync(fd) != 0){
+			throw std::runtime_error("checkpoint: sync failed");
+		}
+	}
+}
+
+klotski_checkpoint_reader::klotski_checkpoint_reader(const std::string& path){
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if(fd < 0){
+		throw std::runtime_error("checkpoint: can not open " + path);
+	}
+	struct stat st;
+	if(::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < fixed_size){
+		::close(fd);
+		throw std::runtime_error("checkpoint: " + path + " is not a checkpoint");
+	}
+	size = static_cast<std::size_t>(st.st_size);
+	void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if(mapped == MAP_FAILED){
+		throw std::runtime_error("checkpoint: can not map " + path);
+	}
+	data = static_cast<const std::uint8_t*>(mapped);
+	::madvise(mapped, size, MADV_SEQUENTIAL);
+
+	header.width = static_cast<int>(get_le(data + 12, 2));
+	header.height = static_cast<int>(get_le(data + 14, 2));
+	header.use_symmetry = data[16] != 0;
+	header.records = get_le(data + records_offset, 8);
+	header.expanded = get_le(data + records_offset + 8, 8);
+	const std::size_t n = static_cast<std::size_t>(header.width) * header.height;
+	if(std::memcmp(data, magic, sizeof(magic)) != 0 || get_le(data + 8, 4) != version
+			|| header.records == 0 || header.expanded > header.records
+			|| size < fixed_size + n * sizeof(std::uint16_t)
+			|| (size - fixed_size - n * sizeof(std::uint16_t)) / entry_size < header.records - 1){
+		::munmap(mapped, size);
+		throw std::runtime_error("checkpoint: " + path + " is not a checkpoint");
+	}
+	for(std::size_t i=0; i<n; ++i){
+		header.root.push_back(static_cast<std::uint16_t>(get_le(data + fixed_size + 2 * i, 2)));
+	}
+	entries = data + get_header_size(header);
+}
+
+klotski_checkpoint_reader::~klotski_checkpoint_reader(){
+	::munmap(const_cast<std::uint8_t*>(data), size);
+}
+
+std::uint32_t klotski_checkpoint_reader::get_parent(std::uint64_t i) const noexcept{
+	return static_cast<std::uint32_t>(get_le(entries + (i - 1) * entry_size, 4));
+}
+
+std::uint8_t klotski_checkpoint_reader::get_direction(std::uint64_t i) const noexcept{
+	return entries[(i - 1) * entry_size + 4];
+}
+
+klotski_checkpoint_writer::klotski_checkpoint_writer(const std::string& path, const klotski_checkpoint_header& header, bool is_append){
+	fd = ::open(path.c_str(), O_RDWR | O_CREAT | (is_append? 0: O_TRUNC), 0644);
+	if(fd < 0){
+		throw std::runtime_error("checkpoint: can not open " + path);
+	}
+	records = header.records;
+	offset = get_header_size(header) + (records - 1) * entry_size;
+	if(is_append){
+		// Drop whatever a crash left past the published count.
+		if(::ftruncate(fd, static_cast<off_t>(offset)) != 0){
+			::close(fd);
+			throw std::runtime_error("checkpoint: can not truncate " + path);
+		}
+		return;
+	}
+	std::vector<std::uint8_t> head(get_header_size(header));
+	std::memcpy(head.data(), magic, sizeof(magic));
+	put_le(head.data() + 8, version, 4);
+	put_le(head.data() + 12, header.width, 2);
+	put_le(head.data() + 14, header.height, 2);
+	head[16] = header.use_symmetry? 1: 0;
+	put_le(head.data() + records_offset, header.records, 8);
+	put_le(head.data() + records_offset + 8, header.expanded, 8);
+	for(std::size_t i=0; i<header.root.size(); ++i){
+		put_le(head.data() + fixed_size + 2 * i, header.root[i], 2);
+	}
+	try{
+		write_at(fd, head.data(), head.size(), 0);
+	}catch(...){
+		::close(fd);
+		throw;
+	}
+}
+
+klotski_checkpoint_writer::~klotski_checkpoint_writer(){
+	::close(fd);
+}
+
+void klotski_checkpoint_writer::append(std::uint32_t parent, std::uint8_t direction){
+	const std::size_t pos = buffer.size();
+	buffer.resize(pos + entry_size);
+	put_le(buffer.data() + pos, parent, 4);
+	buffer[pos + 4] = direction;
+	if(buffer.size() >= buffer_size){
+		flush();
+	}
+}
+
+void klotski_checkpoint_writer::commit(std::uint64_t expanded){
+	flush();
+	sync(fd);
+	std::uint8_t counts[16];
+	put_le(counts, records, 8);
+	put_le(counts + 8, expanded, 8);
+	write_at(fd, counts, sizeof(counts), records_offset);
+	sync(fd);
+}
+
+void klotski_checkpoint_writer::flush(){
+	write_at(fd, buffer.data(), buffer.size(), offset);
+	offset += buffer.size();
+	records += buffer.size() / entry_size;
+	buffer.clear();
+}
@@ -0,0 +1,99 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#ifndef KLOTSKI_CHECKPOINT_H
+#define KLOTSKI_CHECKPOINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// On-disk state of a breadth-first search. Positions are stored in the
+// order they were found, each as the index of its parent and the direction
+// the blank moved, so only the root needs its cells and everything else is
+// replayed on load. The file is little-endian:
+//
+//   "KLOTSKIC" u32 version  u16 width  u16 height  u8 use_symmetry  3 pad
+//   u64 records  u64 expanded  root cells as u16
+//   records - 1 times: u32 parent  u8 direction
+//
+// The positions from index expanded onward are the open queue. Entries
+// past the count in the header are ignored, so the writer appends new ones
+// and only then moves the count forward.
+struct klotski_checkpoint_header{
+	int width = 0;
+	int height = 0;
+	bool use_symmetry = false;
+	std::uint64_t records = 0;
+	std::uint64_t expanded = 0;
+	std::vector<std::uint16_t> root;
+};
+
+class klotski_checkpoint_reader
+{
+	public:
+		// Maps the whole file; throws std::runtime_error if it is not a
+		// checkpoint.
+		explicit klotski_checkpoint_reader(const std::string& path);
+		klotski_checkpoint_reader(const klotski_checkpoint_reader&) = delete;
+		klotski_checkpoint_reader& operator=(const klotski_checkpoint_reader&) = delete;
+
+		const klotski_checkpoint_header& get_header() const noexcept{
+			return header;
+		}
+
+		// Parent and direction of position i, 0 < i < records.
+		std::uint32_t get_parent(std::uint64_t i) const noexcept;
+		std::uint8_t get_direction(std::uint64_t i) const noexcept;
+
+		~klotski_checkpoint_reader();
+
+	private:
+		klotski_checkpoint_header header;
+		const std::uint8_t* data = nullptr;
+		std::size_t size = 0;
+		const std::uint8_t* entries = nullptr;
+};
+
+class klotski_checkpoint_writer
+{
+	public:
+		// Starts a new file, or with is_append continues the one at path,
+		// which must hold the same search.
+		klotski_checkpoint_writer(const std::string& path, const klotski_checkpoint_header& header, bool is_append = false);
+		klotski_checkpoint_writer(const klotski_checkpoint_writer&) = delete;
+		klotski_checkpoint_writer& operator=(const klotski_checkpoint_writer&) = delete;
+
+		void append(std::uint32_t parent, std::uint8_t direction);
+		// Makes everything appended so far durable, then publishes it
+		// together with the new expanded count.
+		void commit(std::uint64_t expanded);
+
+		std::uint64_t get_records() const noexcept{
+			return records;
+		}
+
+		~klotski_checkpoint_writer();
+
+	private:
+		void flush();
+
+		int fd = -1;
+		std::uint64_t records;
+		std::uint64_t offset;
+		std::vector<std::uint8_t> buffer;
+};
+
+#endif
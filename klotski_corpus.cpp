@@ -0,0 +1,246 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#include "klotski_corpus.h"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace{
+	constexpr char magic[8] = {'K', 'L', 'O', 'T', 'S', 'K', 'I', 'B'};
+	constexpr std::uint32_t version = 1;
+	constexpr std::size_t count_offset = 24;
+	constexpr std::size_t header_size = 32;
+	constexpr std::size_t buffer_size = 1024 * 1024;
+
+	std::uint64_t get_le(const std::uint8_t* in, int bytes) noexcept{
+		std::uint64_t value = 0;
+		for(int i=0; i<bytes; ++i){
+			value |= static_cast<std::uint64_t>(in[i]) << (8 * i);
+		}
+		return value;
+	}
+
+	void put_le(std::uint8_t* out, std::uint64_t value, int bytes) noexcept{
+		for(int i=0; i<bytes; ++i){
+			out[i] = static_cast<std::uint8_t>(value >> (8 * i));
+		}
+	}
+
+	void write_at(int fd, const std::uint8_t* data, std::size_t size, std::uint64_t offset){
+		while(size != 0){
+			ssize_t n = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+			if(n < 0){
+				throw std::runtime_error("corpus: write failed");
+			}
+			data += n;
+			size -= n;
+			offset += n;
+		}
+	}
+
+	// Board numbers run from 0 to cells - 1.
+	int get_cell_bytes(int cells) noexcept{
+		return cells <= 256? 1: 2;
+	}
+
+	// Read-only mapping of a whole file, empty files included.
+	class file_map{
+		public:
+			explicit file_map(const std::string& path){
+				int fd = ::open(path.c_str(), O_RDONLY);
+				if(fd < 0){
+					throw std::runtime_error("corpus: can not open " + path);
+				}
+				struct stat st;
+				if(::fstat(fd, &st) != 0){
+					::close(fd);
+					throw std::runtime_error("corpus: can not open " + path);
+				}
+				size = static_cast<std::size_t>(st.st_size);
+				if(size == 0){
+					::close(fd);
+					return;
+				}
+				void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+				::close(fd);
+				if(mapped == MAP_FAILED){
+					throw std::runtime_error("corpus: can not map " + path);
+				}
+				data = static_cast<const std::uint8_t*>(mapped);
+				::madvise(mapped, size, MADV_SEQUENTIAL);
+			}
+			file_map(const file_map&) = delete;
+			file_map& operator=(const file_map&) = delete;
+
+			~file_map(){
+				if(data != nullptr){
+					::munmap(const_cast<std::uint8_t*>(data), size);
+				}
+			}
+
+			const std::uint8_t* data = nullptr;
+			std::size_t size = 0;
+	};
+}
+
+klotski_corpus_reader::klotski_corpus_reader(const std::string& path){
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if(fd < 0){
+		throw std::runtime_error("corpus: can not open " + path);
+	}
+	struct stat st;
+	if(::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < header_size){
+		::close(fd);
+		throw std::runtime_error("corpus: " + path + " is not a corpus");
+	}
+	size = static_cast<std::size_t>(st.st_size);
+	void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if(mapped == MAP_FAILED){
+		throw std::runtime_error("corpus: can not map " + path);
+	}
+	data = static_cast<const std::uint8_t*>(mapped);
+	::madvise(mapped, size, MADV_SEQUENTIAL);
+
+	width = static_cast<int>(get_le(data + 12, 2));
+	height = static_cast<int>(get_le(data + 14, 2));
+	cell_bytes = data[16];
+	count = get_le(data + count_offset, 8);
+	cells = width * height;
+	board_size = static_cast<std::size_t>(cells) * cell_bytes;
+	if(std::memcmp(data, magic, sizeof(magic)) != 0 || get_le(data + 8, 4) != version
+			|| width < 2 || height < 2 || cell_bytes != get_cell_bytes(cells)
+			|| (size - header_size) / board_size < count){
+		::munmap(mapped, size);
+		throw std::runtime_error("corpus: " + path + " is not a corpus");
+	}
+	boards = data + header_size;
+}
+
+klotski_corpus_reader::~klotski_corpus_reader(){
+	::munmap(const_cast<std::uint8_t*>(data), size);
+}
+
+klotski_corpus_writer::klotski_corpus_writer(const std::string& path, int width, int height):
+	path(path),
+	temp_path(path + ".tmp"),
+	cells(width * height),
+	cell_bytes(get_cell_bytes(width * height)),
+	offset(header_size){
+		if(width < 2 || height < 2 || width > 0xffff || height > 0xffff || cells > 0x10000){
+			throw std::invalid_argument("corpus: board size is not supported");
+		}
+		fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(fd < 0){
+			throw std::runtime_error("corpus: can not open " + temp_path);
+		}
+		std::uint8_t head[header_size] = {};
+		std::memcpy(head, magic, sizeof(magic));
+		put_le(head + 8, version, 4);
+		put_le(head + 12, width, 2);
+		put_le(head + 14, height, 2);
+		head[16] = static_cast<std::uint8_t>(cell_bytes);
+		try{
+			write_at(fd, head, header_size, 0);
+		}catch(...){
+			::close(fd);
+			::unlink(temp_path.c_str());
+			throw;
+		}
+		buffer.reserve(buffer_size);
+	}
+
+klotski_corpus_writer::~klotski_corpus_writer(){
+	if(!is_closed){
+		::close(fd);
+		::unlink(temp_path.c_str());
+	}
+}
+
+void klotski_corpus_writer::append(const int* board){
+	const std::size_t pos = buffer.size();
+	buffer.resize(pos + static_cast<std::size_t>(cells) * cell_bytes);
+	std::uint8_t* out = buffer.data() + pos;
+	for(int i=0; i<cells; ++i){
+		if(board[i] < 0 || board[i] >= cells){
+			buffer.resize(pos);
+			throw std::runtime_error("corpus: board number out of range");
+		}
+		put_le(out + i * cell_bytes, static_cast<std::uint64_t>(board[i]), cell_bytes);
+	}
+	++count;
+	if(buffer.size() >= buffer_size){
+		flush();
+	}
+}
+
+void klotski_corpus_writer::close(){
+	flush();
+	std::uint8_t counts[8];
+	put_le(counts, count, 8);
+	write_at(fd, counts, sizeof(counts), count_offset);
+	is_closed = true;
+	const int result = ::close(fd);
+	if(result != 0 || ::rename(temp_path.c_str(), path.c_str()) != 0){
+		::unlink(temp_path.c_str());
+		throw std::runtime_error("corpus: can not write " + path);
+	}
+}
+
+void klotski_corpus_writer::flush(){
+	write_at(fd, buffer.data(), buffer.size(), offset);
+	offset += buffer.size();
+	buffer.clear();
+}
+
+std::uint64_t klotski_convert_corpus(const std::string& text_path, const std::string& corpus_path, int width, int height){
+	file_map text(text_path);
+	klotski_corpus_writer writer(corpus_path, width, height);
+	std::vector<int> board(static_cast<std::size_t>(width) * height);
+	std::size_t filled = 0;
+	const std::uint8_t* p = text.data;
+	const std::uint8_t* const end = p + text.size;
+	while(p != end){
+		const std::uint8_t c = *p;
+		if(c == ' ' || c == ',' || c == '\n' || c == '\r' || c == '\t'){
+			++p;
+			continue;
+		}
+		if(c < '0' || c > '9'){
+			throw std::runtime_error("corpus: " + text_path + " is not a valid board file");
+		}
+		int n = 0;
+		while(p != end && *p >= '0' && *p <= '9'){
+			n = n * 10 + (*p++ - '0');
+			if(n > 0xffff){
+				throw std::runtime_error("corpus: board number out of range");
+			}
+		}
+		board[filled++] = n;
+		if(filled == board.size()){
+			writer.append(board.data());
+			filled = 0;
+		}
+	}
+	if(filled != 0){
+		throw std::runtime_error("corpus: " + text_path + " ends inside a board");
+	}
+	writer.close();
+	return writer.get_count();
+}
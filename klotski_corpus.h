@@ -0,0 +1,179 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#ifndef KLOTSKI_CORPUS_H
+#define KLOTSKI_CORPUS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Many boards of one size packed back to back. Every board is width *
+// height cells in row order, one byte per cell when the numbers fit in a
+// byte and two otherwise. The file is little-endian:
+//
+//   "KLOTSKIB" u32 version  u16 width  u16 height  u8 cell_bytes  7 pad
+//   u64 count  count boards of width * height cells
+//
+// Boards start 32 bytes in, so two-byte cells stay aligned.
+class klotski_corpus_reader
+{
+	public:
+		// Walks the cells of one board in the mapping without copying them;
+		// it fits the klotski_board(situation_array, dx, dy) constructor.
+		class board_view{
+			public:
+				class const_iterator{
+					public:
+						const_iterator(const std::uint8_t* cell, int cell_bytes) noexcept:
+							cell(cell), cell_bytes(cell_bytes){}
+
+						int operator*() const noexcept{
+							return cell_bytes == 1? cell[0]: cell[0] | cell[1] << 8;
+						}
+
+						const_iterator& operator++() noexcept{
+							cell += cell_bytes;
+							return *this;
+						}
+
+						const_iterator operator++(int) noexcept{
+							const_iterator old = *this;
+							cell += cell_bytes;
+							return old;
+						}
+
+						bool operator==(const const_iterator& other) const noexcept{
+							return cell == other.cell;
+						}
+
+						bool operator!=(const const_iterator& other) const noexcept{
+							return cell != other.cell;
+						}
+
+					private:
+						const std::uint8_t* cell;
+						int cell_bytes;
+				};
+
+				board_view(const std::uint8_t* data, int cells, int cell_bytes) noexcept:
+					data(data), cells(cells), cell_bytes(cell_bytes){}
+
+				int operator[](int i) const noexcept{
+					return *const_iterator(data + i * cell_bytes, cell_bytes);
+				}
+
+				int size() const noexcept{
+					return cells;
+				}
+
+				const_iterator cbegin() const noexcept{
+					return const_iterator(data, cell_bytes);
+				}
+
+				const_iterator cend() const noexcept{
+					return const_iterator(data + cells * cell_bytes, cell_bytes);
+				}
+
+				const_iterator begin() const noexcept{
+					return cbegin();
+				}
+
+				const_iterator end() const noexcept{
+					return cend();
+				}
+
+			private:
+				const std::uint8_t* data;
+				int cells;
+				int cell_bytes;
+		};
+
+		// Maps the whole file; throws std::runtime_error if it is not a
+		// corpus.
+		explicit klotski_corpus_reader(const std::string& path);
+		klotski_corpus_reader(const klotski_corpus_reader&) = delete;
+		klotski_corpus_reader& operator=(const klotski_corpus_reader&) = delete;
+
+		board_view get_board(std::uint64_t i) const noexcept{
+			return board_view(boards + i * board_size, cells, cell_bytes);
+		}
+
+		int get_width() const noexcept{
+			return width;
+		}
+
+		int get_height() const noexcept{
+			return height;
+		}
+
+		std::uint64_t get_count() const noexcept{
+			return count;
+		}
+
+		~klotski_corpus_reader();
+
+	private:
+		const std::uint8_t* data = nullptr;
+		std::size_t size = 0;
+		const std::uint8_t* boards = nullptr;
+		int width = 0;
+		int height = 0;
+		int cells = 0;
+		int cell_bytes = 0;
+		std::size_t board_size = 0;
+		std::uint64_t count = 0;
+};
+
+class klotski_corpus_writer
+{
+	public:
+		klotski_corpus_writer(const std::string& path, int width, int height);
+		klotski_corpus_writer(const klotski_corpus_writer&) = delete;
+		klotski_corpus_writer& operator=(const klotski_corpus_writer&) = delete;
+
+		// Takes width * height cells in row order.
+		void append(const int* cells);
+		// Writes the remaining boards and the final count, then puts the
+		// corpus at its path. Without a close nothing appears there.
+		void close();
+
+		std::uint64_t get_count() const noexcept{
+			return count;
+		}
+
+		~klotski_corpus_writer();
+
+	private:
+		void flush();
+
+		std::string path;
+		// Written first and renamed to path on close, so that a failed
+		// write never leaves a valid corpus behind.
+		std::string temp_path;
+		int fd = -1;
+		bool is_closed = false;
+		int cells;
+		int cell_bytes;
+		std::uint64_t count = 0;
+		std::uint64_t offset;
+		std::vector<std::uint8_t> buffer;
+};
+
+// Converts boards written as in -f files, numbers separated by blanks,
+// commas or line breaks, into a corpus and returns how many it holds.
+std::uint64_t klotski_convert_corpus(const std::string& text_path, const std::string& corpus_path, int width, int height);
+
+#endif
@@ -0,0 +1,826 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#include "klotski_distributed.h"
+#include "klotski_simd.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory_resource>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace{
+	constexpr std::size_t header_size = 5;
+	constexpr std::size_t batch_size = 64 * 1024;
+	// A batch runs over batch_size by at most one state of the largest
+	// board, and no other message is bigger.
+	constexpr std::size_t max_message_size = 4 + batch_size + 13 + 2 * 0xffff;
+	constexpr int connect_timeout_seconds = 30;
+
+	void put_u16(std::vector<std::uint8_t>& out, std::uint16_t value){
+		out.push_back(static_cast<std::uint8_t>(value));
+		out.push_back(static_cast<std::uint8_t>(value >> 8));
+	}
+
+	void put_u32(std::vector<std::uint8_t>& out, std::uint32_t value){
+		for(int i=0; i<4; ++i){
+			out.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+		}
+	}
+
+	void put_u64(std::vector<std::uint8_t>& out, std::uint64_t value){
+		for(int i=0; i<8; ++i){
+			out.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+		}
+	}
+
+	std::uint16_t get_u16(const std::uint8_t* in){
+		return static_cast<std::uint16_t>(in[0] | in[1] << 8);
+	}
+
+	std::uint32_t get_u32(const std::uint8_t* in){
+		std::uint32_t value = 0;
+		for(int i=0; i<4; ++i){
+			value |= static_cast<std::uint32_t>(in[i]) << (8 * i);
+		}
+		return value;
+	}
+
+	std::uint64_t get_u64(const std::uint8_t* in){
+		std::uint64_t value = 0;
+		for(int i=0; i<8; ++i){
+			value |= static_cast<std::uint64_t>(in[i]) << (8 * i);
+		}
+		return value;
+	}
+
+	void write_all(int fd, const std::uint8_t* data, std::size_t size){
+		while(size != 0){
+			ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+			if(n < 0){
+				if(errno == EINTR){
+					continue;
+				}
+				throw std::runtime_error(std::string("distributed: send failed: ") + std::strerror(errno));
+			}
+			data += n;
+			size -= n;
+		}
+	}
+
+	void read_all(int fd, std::uint8_t* data, std::size_t size){
+		while(size != 0){
+			ssize_t n = ::recv(fd, data, size, 0);
+			if(n <= 0){
+				if(n < 0 && errno == EINTR){
+					continue;
+				}
+				throw std::runtime_error("distributed: worker disconnected during handshake");
+			}
+			data += n;
+			size -= n;
+		}
+	}
+
+	int connect_to(const std::string& host, int port){
+		addrinfo hints{};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(connect_timeout_seconds);
+		while(true){
+			addrinfo* result = nullptr;
+			if(::getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) == 0){
+				for(addrinfo* ai=result; ai!=nullptr; ai=ai->ai_next){
+					int fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+					if(fd < 0){
+						continue;
+					}
+					if(::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0){
+						::freeaddrinfo(result);
+						return fd;
+					}
+					::close(fd);
+				}
+				::freeaddrinfo(result);
+			}
+			if(std::chrono::steady_clock::now() > deadline){
+				throw std::runtime_error("distributed: can not connect to " + host + ":" + std::to_string(port));
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+	}
+}
+
+struct klotski_distributed::record_item{
+	klotski_search_state<klotski_dynamic_geometry> state;
+	std::uint8_t direction;
+
+	std::uint16_t* cells() noexcept{
+		return reinterpret_cast<std::uint16_t*>(this + 1);
+	}
+
+	const std::uint16_t* cells() const noexcept{
+		return reinterpret_cast<const std::uint16_t*>(this + 1);
+	}
+};
+
+// The slice of one search owned by this worker.
+struct klotski_distributed::partition{
+	class record_hash{
+		public:
+			size_t operator()(const record_item* item) const noexcept{
+				return static_cast<size_t>(item->state.hash);
+			}
+	};
+
+	class record_equal{
+		public:
+			explicit record_equal(int n) noexcept: n(n){}
+			bool operator()(const record_item* a, const record_item* b) const noexcept{
+				return a->state.hash == b->state.hash
+					&& std::memcmp(a->cells(), b->cells(), n * sizeof(std::uint16_t)) == 0;
+			}
+		private:
+			int n;
+	};
+
+	partition(int width, int height):
+		geometry(width, height),
+		arena(1024 * 1024),
+		visited(1024, record_hash(), record_equal(geometry.get_size()), arena.get_resource()){}
+
+	record_item* new_record(){
+		void* memory = arena.get_resource()->allocate(
+				sizeof(record_item) + geometry.get_size() * sizeof(std::uint16_t), alignof(record_item));
+		return new (memory) record_item;
+	}
+
+	const record_item* find(const std::uint16_t* cells){
+		if(spare == nullptr){
+			spare = new_record();
+		}
+		std::memcpy(spare->cells(), cells, geometry.get_size() * sizeof(std::uint16_t));
+		spare->state.init(geometry, spare->cells());
+		auto it = visited.find(spare);
+		return it == visited.end()? nullptr: *it;
+	}
+
+	klotski_dynamic_geometry geometry;
+	klotski_arena arena;
+	std::pmr::unordered_set<const record_item*, record_hash, record_equal> visited;
+	std::vector<const record_item*> frontier;
+	std::vector<const record_item*> next;
+	record_item* spare = nullptr;
+	bool found = false;
+};
+
+klotski_distributed::klotski_distributed(const std::vector<endpoint>& endpoints, int worker_id):
+	klotski_distributed(listen_on("", endpoints.at(worker_id).port), endpoints, worker_id){
+	}
+
+klotski_distributed::klotski_distributed(int listen_fd, const std::vector<endpoint>& endpoints, int worker_id):
+	worker_id(worker_id),
+	peers(endpoints.size()){
+		try{
+			connect_peers(listen_fd, endpoints);
+		}catch(...){
+			::close(listen_fd);
+			throw;
+		}
+		::close(listen_fd);
+	}
+
+klotski_distributed::~klotski_distributed(){
+	try{
+		shutdown();
+	}catch(const std::exception&){
+	}
+	for(auto& p: peers){
+		if(p.fd >= 0){
+			::close(p.fd);
+		}
+	}
+	for(pid_t pid: children){
+		::waitpid(pid, nullptr, 0);
+	}
+}
+
+std::shared_ptr<klotski_distributed> klotski_distributed::launch_local(int workers){
+	if(workers < 1){
+		throw std::invalid_argument("distributed: at least one worker is required");
+	}
+	std::vector<int> listeners;
+	std::vector<endpoint> endpoints;
+	for(int i=0; i<workers; ++i){
+		int fd = listen_on("127.0.0.1", 0);
+		sockaddr_in address{};
+		socklen_t length = sizeof(address);
+		::getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length);
+		listeners.push_back(fd);
+		endpoints.push_back(endpoint{"127.0.0.1", ntohs(address.sin_port)});
+	}
+	std::cout.flush();
+	std::vector<pid_t> children;
+	for(int i=1; i<workers; ++i){
+		pid_t pid = ::fork();
+		if(pid < 0){
+			throw std::runtime_error("distributed: fork failed");
+		}
+		if(pid == 0){
+			for(int j=0; j<workers; ++j){
+				if(j != i){
+					::close(listeners[j]);
+				}
+			}
+			try{
+				klotski_distributed worker(listeners[i], endpoints, i);
+				worker.serve();
+			}catch(const std::exception& e){
+				std::cerr<<"worker "<<i<<": "<<e.what()<<std::endl;
+				::_exit(EXIT_FAILURE);
+			}
+			::_exit(EXIT_SUCCESS);
+		}
+		children.push_back(pid);
+		::close(listeners[i]);
+	}
+	std::shared_ptr<klotski_distributed> coordinator(new klotski_distributed(listeners[0], endpoints, 0));
+	coordinator->children = std::move(children);
+	return coordinator;
+}
+
+std::vector<klotski_distributed::endpoint> klotski_distributed::parse_endpoints(const std::string& endpoints_string){
+	std::vector<endpoint> endpoints;
+	std::stringstream ss(endpoints_string);
+	std::string item;
+	while(std::getline(ss, item, ',')){
+		auto pos = item.find_last_of(':');
+		if(pos == std::string::npos || pos == 0){
+			throw std::invalid_argument("invalid worker address: " + item);
+		}
+		try{
+			endpoints.push_back(endpoint{item.substr(0, pos), std::stoi(item.substr(pos + 1))});
+		}catch(const std::logic_error&){
+			throw std::invalid_argument("invalid worker address: " + item);
+		}
+	}
+	if(endpoints.empty()){
+		throw std::invalid_argument("no worker addresses");
+	}
+	return endpoints;
+}
+
+int klotski_distributed::listen_on(const std::string& host, int port){
+	addrinfo hints{};
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	addrinfo* result = nullptr;
+	if(::getaddrinfo(host.empty()? nullptr: host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0){
+		throw std::runtime_error("distributed: can not resolve " + host);
+	}
+	int fd = ::socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+	int enable = 1;
+	if(fd < 0
+			|| ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) != 0
+			|| ::bind(fd, result->ai_addr, result->ai_addrlen) != 0
+			|| ::listen(fd, SOMAXCONN) != 0){
+		::freeaddrinfo(result);
+		if(fd >= 0){
+			::close(fd);
+		}
+		throw std::runtime_error("distributed: can not listen on port " + std::to_string(port));
+	}
+	::freeaddrinfo(result);
+	return fd;
+}
+
+// Worker i dials every lower id and accepts every higher one, so the mesh
+// comes up without any ordering between process starts.
+void klotski_distributed::connect_peers(int listen_fd, const std::vector<endpoint>& endpoints){
+	const int workers = static_cast<int>(endpoints.size());
+	if(worker_id < 0 || worker_id >= workers){
+		throw std::invalid_argument("distributed: worker id out of range");
+	}
+	for(int i=0; i<worker_id; ++i){
+		int fd = connect_to(endpoints[i].host, endpoints[i].port);
+		std::vector<std::uint8_t> hello{Hello};
+		put_u32(hello, 4);
+		put_u32(hello, static_cast<std::uint32_t>(worker_id));
+		write_all(fd, hello.data(), hello.size());
+		peers[i].fd = fd;
+	}
+	for(int accepted=worker_id+1; accepted<workers; ++accepted){
+		int fd = ::accept(listen_fd, nullptr, nullptr);
+		if(fd < 0){
+			throw std::runtime_error("distributed: accept failed");
+		}
+		std::uint8_t hello[header_size + 4];
+		read_all(fd, hello, sizeof(hello));
+		const std::uint32_t id = get_u32(hello + header_size);
+		if(hello[0] != Hello || id <= static_cast<std::uint32_t>(worker_id)
+				|| id >= static_cast<std::uint32_t>(workers) || peers[id].fd >= 0){
+			::close(fd);
+			throw std::runtime_error("distributed: unexpected handshake");
+		}
+		peers[id].fd = fd;
+	}
+	for(auto& p: peers){
+		if(p.fd < 0){
+			continue;
+		}
+		int enable = 1;
+		::setsockopt(p.fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+		::fcntl(p.fd, F_SETFL, ::fcntl(p.fd, F_GETFL) | O_NONBLOCK);
+	}
+}
+
+bool klotski_distributed::search(const klotski_board::situation_type& situation, std::deque<klotski_board::situation_type>& route){
+	if(worker_id != 0){
+		throw std::logic_error("distributed: only worker 0 can start a search");
+	}
+	const int height = static_cast<int>(situation.size());
+	const int width = static_cast<int>(situation.front().size());
+	std::vector<std::uint16_t> cells;
+	for(const auto& i: situation){
+		for(int j: i){
+			cells.push_back(static_cast<std::uint16_t>(j));
+		}
+	}
+	std::vector<std::uint8_t> payload;
+	put_u16(payload, static_cast<std::uint16_t>(width));
+	put_u16(payload, static_cast<std::uint16_t>(height));
+	for(auto cell: cells){
+		put_u16(payload, cell);
+	}
+	for(int i=1; i<get_workers(); ++i){
+		send_message(i, Start, payload);
+	}
+	begin_search(width, height, cells);
+	const bool is_found = run_layers();
+
+	route.clear();
+	if(is_found){
+		auto& p = *current;
+		const int n = p.geometry.get_size();
+		std::vector<std::uint16_t> state(p.geometry.get_goal(), p.geometry.get_goal() + n);
+		std::deque<std::pair<std::vector<std::uint16_t>, int>> path;
+		while(true){
+			klotski_search_state<klotski_dynamic_geometry> key;
+			key.init(p.geometry, state.data());
+			const int owner = get_owner(key.hash);
+			int direction;
+			if(owner == 0){
+				const record_item* item = p.find(state.data());
+				direction = item != nullptr? item->direction: -1;
+			}else{
+				std::vector<std::uint8_t> request;
+				encode_cells(state.data(), request);
+				parent_response = -1;
+				send_message(owner, ParentRequest, request);
+				while(parent_response < 0){
+					pump(true);
+				}
+				direction = parent_response == 0xff? -1: parent_response;
+			}
+			if(direction < 0){
+				throw std::runtime_error("distributed: route is broken");
+			}
+			path.emplace_front(state, direction);
+			if(direction == DirectionCount){
+				break;
+			}
+			const int zero = key.zero;
+			const int parent_zero = p.geometry.neighbor(zero, direction ^ 1);
+			if(parent_zero < 0){
+				throw std::runtime_error("distributed: route is broken");
+			}
+			state[zero] = state[parent_zero];
+			state[parent_zero] = 0;
+		}
+		// Same collapsing as the single process engine: walking back from the
+		// goal, keep a position whenever the move orientation changes.
+		bool last_horizontal = false;
+		for(auto it=path.rbegin(); it!=path.rend(); ++it){
+			const bool is_horizontal = it->second == Left || it->second == Right;
+			if(it == path.rbegin() || it->second == DirectionCount || is_horizontal != last_horizontal){
+				klotski_board::situation_type situation_cur(height, std::vector<int>(width));
+				for(int pos=0; pos<n; ++pos){
+					situation_cur[pos / width][pos % width] = it->first[pos];
+				}
+				route.push_front(std::move(situation_cur));
+				last_horizontal = is_horizontal;
+			}
+		}
+	}
+	for(int i=1; i<get_workers(); ++i){
+		send_message(i, SearchEnd, {});
+	}
+	current.reset();
+	return is_found;
+}
+
+void klotski_distributed::serve(){
+	while(!is_shutdown){
+		while(!is_start_pending && !is_shutdown){
+			pump(true);
+		}
+		if(is_shutdown){
+			break;
+		}
+		is_start_pending = false;
+		run_layers();
+		while(!is_search_over && !is_shutdown){
+			pump(true);
+		}
+		is_search_over = false;
+	}
+}
+
+void klotski_distributed::shutdown(){
+	if(worker_id != 0 || is_shutdown){
+		return;
+	}
+	is_shutdown = true;
+	for(int i=1; i<get_workers(); ++i){
+		send_message(i, Shutdown, {});
+	}
+	bool is_pending = true;
+	while(is_pending){
+		is_pending = false;
+		for(const auto& p: peers){
+			if(p.fd >= 0 && p.outbox_sent < p.outbox.size()){
+				is_pending = true;
+			}
+		}
+		if(is_pending){
+			pump(true);
+		}
+	}
+}
+
+void klotski_distributed::send_message(int to, message_type type, const std::vector<std::uint8_t>& payload){
+	auto& out = peers[to].outbox;
+	out.push_back(type);
+	put_u32(out, static_cast<std::uint32_t>(payload.size()));
+	out.insert(out.end(), payload.begin(), payload.end());
+}
+
+void klotski_distributed::flush_batch(int to){
+	auto& p = peers[to];
+	if(p.batch_count == 0){
+		return;
+	}
+	std::vector<std::uint8_t> payload;
+	payload.reserve(4 + p.batch.size());
+	put_u32(payload, p.batch_count);
+	payload.insert(payload.end(), p.batch.begin(), p.batch.end());
+	send_message(to, States, payload);
+	p.batch.clear();
+	p.batch_count = 0;
+}
+
+void klotski_distributed::pump(bool block){
+	std::vector<pollfd> fds;
+	std::vector<int> ids;
+	for(int i=0; i<get_workers(); ++i){
+		const auto& p = peers[i];
+		if(p.fd < 0){
+			continue;
+		}
+		short events = POLLIN;
+		if(p.outbox_sent < p.outbox.size()){
+			events |= POLLOUT;
+		}
+		fds.push_back(pollfd{p.fd, events, 0});
+		ids.push_back(i);
+	}
+	if(fds.empty()){
+		return;
+	}
+	if(::poll(fds.data(), fds.size(), block? -1: 0) < 0){
+		if(errno == EINTR){
+			return;
+		}
+		throw std::runtime_error("distributed: poll failed");
+	}
+	for(std::size_t k=0; k<fds.size(); ++k){
+		auto& p = peers[ids[k]];
+		if(fds[k].revents & POLLOUT){
+			ssize_t n = ::send(p.fd, p.outbox.data() + p.outbox_sent, p.outbox.size() - p.outbox_sent, MSG_NOSIGNAL);
+			if(n > 0){
+				p.outbox_sent += n;
+				if(p.outbox_sent == p.outbox.size()){
+					p.outbox.clear();
+					p.outbox_sent = 0;
+				}
+			}else if(n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+				throw std::runtime_error("distributed: lost connection to worker " + std::to_string(ids[k]));
+			}
+		}
+		if(fds[k].revents & (POLLIN | POLLHUP | POLLERR)){
+			std::uint8_t buffer[64 * 1024];
+			bool is_closed = false;
+			while(true){
+				ssize_t n = ::recv(p.fd, buffer, sizeof(buffer), 0);
+				if(n > 0){
+					p.inbox.insert(p.inbox.end(), buffer, buffer + n);
+					continue;
+				}
+				if(n < 0 && errno == EINTR){
+					continue;
+				}
+				is_closed = n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+				break;
+			}
+			std::size_t offset = 0;
+			while(p.inbox.size() - offset >= header_size){
+				const std::uint32_t size = get_u32(p.inbox.data() + offset + 1);
+				if(size > max_message_size){
+					throw std::runtime_error("distributed: oversized message from worker " + std::to_string(ids[k]));
+				}
+				if(p.inbox.size() - offset < header_size + size){
+					break;
+				}
+				handle_message(ids[k], static_cast<message_type>(p.inbox[offset]),
+						p.inbox.data() + offset + header_size, size);
+				offset += header_size + size;
+			}
+			p.inbox.erase(p.inbox.begin(), p.inbox.begin() + offset);
+			if(is_closed){
+				::close(p.fd);
+				p.fd = -1;
+				// Workers hang up on each other once told to shut down, which may
+				// be before the word reaches this one. A worker that really died
+				// is noticed by the coordinator, whose exit then reaches everyone.
+				if(!is_shutdown && (worker_id == 0 || ids[k] == 0)){
+					throw std::runtime_error("distributed: lost connection to worker " + std::to_string(ids[k]));
+				}
+			}
+		}
+	}
+}
+
+// Workers listen on every interface with no authentication, so nothing in
+// a message is trusted: its size has to be what its type calls for, and
+// the messages of a search only come while one is running.
+void klotski_distributed::handle_message(int from, message_type type, const std::uint8_t* payload, std::size_t size){
+	const auto expect = [&](bool is_valid){
+		if(!is_valid){
+			throw std::runtime_error("distributed: malformed message from worker " + std::to_string(from));
+		}
+	};
+	switch(type){
+		case Start:{
+			expect(current == nullptr && size >= 4);
+			const int width = get_u16(payload);
+			const int height = get_u16(payload + 2);
+			const std::size_t n = static_cast<std::size_t>(width) * height;
+			expect(width >= 2 && height >= 2 && n <= 0xffff && size == 4 + 2 * n);
+			std::vector<std::uint16_t> cells(n);
+			for(std::size_t i=0; i<cells.size(); ++i){
+				cells[i] = get_u16(payload + 4 + 2 * i);
+			}
+			expect(klotski_board::is_valid(cells.data(), width, height));
+			begin_search(width, height, cells);
+			is_start_pending = true;
+			break;
+		}
+		case States:{
+			expect(current != nullptr && size >= 4);
+			const int n = current->geometry.get_size();
+			const std::size_t entry_size = 1 + 8 + 4 + static_cast<std::size_t>(n) * get_cell_bytes();
+			const std::uint32_t count = get_u32(payload);
+			expect((size - 4) / entry_size == count && (size - 4) % entry_size == 0);
+			std::vector<std::uint16_t> cells(n);
+			const std::uint8_t* entry = payload + 4;
+			for(std::uint32_t i=0; i<count; ++i, entry+=entry_size){
+				klotski_search_state<klotski_dynamic_geometry> state;
+				state.hash = get_u64(entry + 1);
+				state.mirror_hash = 0;
+				state.heuristic = get_u32(entry + 9);
+				decode_cells(entry + 13, cells.data());
+				state.zero = static_cast<std::uint16_t>(klotski_simd::find(cells.data(), n, std::uint16_t(0)));
+				expect(entry[0] < DirectionCount && state.zero < n);
+				expect(std::all_of(cells.begin(), cells.end(), [n](std::uint16_t cell){ return cell < n; }));
+				insert_state(cells.data(), state, entry[0]);
+			}
+			break;
+		}
+		case LayerEnd:
+			expect(current != nullptr && size == 0);
+			++layer_end_count;
+			break;
+		case LayerDone:
+			expect(current != nullptr && size == 9);
+			layer_next_states += get_u64(payload);
+			layer_found = layer_found || payload[8] != 0;
+			++layer_done_count;
+			break;
+		case Decision:
+			expect(current != nullptr && size == 1 && payload[0] <= Exhausted);
+			decision = payload[0];
+			break;
+		case ParentRequest:{
+			expect(current != nullptr && size == static_cast<std::size_t>(current->geometry.get_size()) * get_cell_bytes());
+			std::vector<std::uint16_t> cells(current->geometry.get_size());
+			decode_cells(payload, cells.data());
+			const record_item* item = current->find(cells.data());
+			send_message(from, ParentResponse, {static_cast<std::uint8_t>(item != nullptr? item->direction: 0xff)});
+			break;
+		}
+		case ParentResponse:
+			expect(current != nullptr && size == 1 && (payload[0] <= DirectionCount || payload[0] == 0xff));
+			parent_response = payload[0];
+			break;
+		case SearchEnd:
+			expect(size == 0);
+			current.reset();
+			is_search_over = true;
+			break;
+		case Shutdown:
+			expect(size == 0);
+			is_shutdown = true;
+			break;
+		default:
+			throw std::runtime_error("distributed: unexpected message");
+	}
+}
+
+void klotski_distributed::begin_search(int width, int height, const std::vector<std::uint16_t>& cells){
+	current = std::make_unique<partition>(width, height);
+	layer_end_count = 0;
+	layer_done_count = 0;
+	layer_next_states = 0;
+	layer_found = false;
+	decision = -1;
+	klotski_search_state<klotski_dynamic_geometry> state;
+	state.init(current->geometry, cells.data());
+	if(get_owner(state.hash) == worker_id){
+		insert_state(cells.data(), state, DirectionCount);
+	}
+	current->frontier.swap(current->next);
+}
+
+// Every layer starts with a barrier through worker 0, which also makes sure
+// all workers have set up the search before the first successors arrive.
+bool klotski_distributed::run_layers(){
+	auto& p = *current;
+	const int others = get_workers() - 1;
+	last_states = 0;
+	last_layers = 0;
+	while(true){
+		if(worker_id == 0){
+			while(layer_done_count < others){
+				pump(true);
+			}
+			layer_done_count -= others;
+			layer_next_states += p.frontier.size();
+			layer_found = layer_found || p.found;
+			last_states += layer_next_states;
+			const std::uint8_t result = layer_found? Found: layer_next_states == 0? Exhausted: Continue;
+			layer_next_states = 0;
+			layer_found = false;
+			for(int i=1; i<get_workers(); ++i){
+				send_message(i, Decision, {result});
+			}
+			decision = result;
+		}else{
+			std::vector<std::uint8_t> report;
+			put_u64(report, p.frontier.size());
+			report.push_back(p.found? 1: 0);
+			decision = -1;
+			send_message(0, LayerDone, report);
+			while(decision < 0){
+				pump(true);
+			}
+		}
+		if(decision != Continue){
+			return decision == Found;
+		}
+		++last_layers;
+		expand_layer();
+		for(int i=0; i<get_workers(); ++i){
+			if(i != worker_id){
+				flush_batch(i);
+				send_message(i, LayerEnd, {});
+			}
+		}
+		while(layer_end_count < others){
+			pump(true);
+		}
+		layer_end_count -= others;
+		p.frontier.swap(p.next);
+		p.next.clear();
+	}
+}
+
+void klotski_distributed::expand_layer(){
+	auto& p = *current;
+	const int n = p.geometry.get_size();
+	std::vector<std::uint16_t> cells(n);
+	for(const record_item* item: p.frontier){
+		const int zero = item->state.zero;
+		for(int direction=0; direction<DirectionCount; ++direction){
+			const int target = p.geometry.neighbor(zero, direction);
+			if(target < 0 || (item->direction != DirectionCount && direction == (item->direction ^ 1))){
+				continue;
+			}
+			std::memcpy(cells.data(), item->cells(), n * sizeof(std::uint16_t));
+			const int tile = cells[target];
+			cells[zero] = static_cast<std::uint16_t>(tile);
+			cells[target] = 0;
+			auto state = item->state;
+			state.move(p.geometry, target, tile);
+			const int owner = get_owner(state.hash);
+			if(owner == worker_id){
+				insert_state(cells.data(), state, direction);
+				continue;
+			}
+			auto& to = peers[owner];
+			to.batch.push_back(static_cast<std::uint8_t>(direction));
+			put_u64(to.batch, state.hash);
+			put_u32(to.batch, state.heuristic);
+			encode_cells(cells.data(), to.batch);
+			++to.batch_count;
+			if(to.batch.size() >= batch_size){
+				flush_batch(owner);
+				pump(false);
+			}
+		}
+	}
+}
+
+void klotski_distributed::insert_state(const std::uint16_t* cells, const klotski_search_state<klotski_dynamic_geometry>& state, int direction){
+	auto& p = *current;
+	if(p.spare == nullptr){
+		p.spare = p.new_record();
+	}
+	std::memcpy(p.spare->cells(), cells, p.geometry.get_size() * sizeof(std::uint16_t));
+	p.spare->state = state;
+	p.spare->direction = static_cast<std::uint8_t>(direction);
+	if(!p.visited.insert(p.spare).second){
+		return;
+	}
+	p.next.push_back(p.spare);
+	if(state.heuristic == 0){
+		p.found = true;
+	}
+	p.spare = nullptr;
+}
+
+int klotski_distributed::get_owner(std::uint64_t hash) const noexcept{
+	return static_cast<int>((hash >> 32) % static_cast<std::uint64_t>(get_workers()));
+}
+
+void klotski_distributed::encode_cells(const std::uint16_t* cells, std::vector<std::uint8_t>& out) const{
+	const int n = current->geometry.get_size();
+	if(get_cell_bytes() == 1){
+		out.insert(out.end(), cells, cells + n);
+	}else{
+		for(int i=0; i<n; ++i){
+			put_u16(out, cells[i]);
+		}
+	}
+}
+
+void klotski_distributed::decode_cells(const std::uint8_t* in, std::uint16_t* cells) const{
+	const int n = current->geometry.get_size();
+	if(get_cell_bytes() == 1){
+		std::copy(in, in + n, cells);
+	}else{
+		for(int i=0; i<n; ++i){
+			cells[i] = get_u16(in + 2 * i);
+		}
+	}
+}
+
+int klotski_distributed::get_cell_bytes() const noexcept{
+	return current->geometry.get_size() <= 256? 1: 2;
+}
@@ -0,0 +1,145 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#ifndef KLOTSKI_DISTRIBUTED_H
+#define KLOTSKI_DISTRIBUTED_H
+
+#include "klotski_arena.h"
+#include "klotski_board.h"
+#include "klotski_geometry.h"
+#include "klotski_search_engine.h"
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+// Breadth-first search spread over several processes. Every worker owns
+// the positions whose hash falls into its partition: it keeps them in its
+// own visited set, expands the ones in the current layer and ships each
+// successor to its owner in batched messages. A layer ends once every
+// worker has heard the end marker of every peer, and worker 0 then decides
+// whether the next layer runs. Worker 0 also coordinates: it starts each
+// search and rebuilds the route by asking owners for the move that led to
+// each position.
+class klotski_distributed
+{
+	public:
+		struct endpoint{
+			std::string host;
+			int port;
+		};
+
+		klotski_distributed(const std::vector<endpoint>& endpoints, int worker_id);
+		klotski_distributed(const klotski_distributed&) = delete;
+		klotski_distributed& operator=(const klotski_distributed&) = delete;
+
+		// Forks workers - 1 local processes that serve until shutdown and
+		// returns worker 0 of the group.
+		static std::shared_ptr<klotski_distributed> launch_local(int workers);
+		static std::vector<endpoint> parse_endpoints(const std::string& endpoints_string);
+
+		bool search(const klotski_board::situation_type& situation, std::deque<klotski_board::situation_type>& route);
+		void serve();
+		void shutdown();
+
+		int get_worker_id() const noexcept{
+			return worker_id;
+		}
+
+		int get_workers() const noexcept{
+			return static_cast<int>(peers.size());
+		}
+
+		std::uint64_t get_last_states() const noexcept{
+			return last_states;
+		}
+
+		int get_last_layers() const noexcept{
+			return last_layers;
+		}
+
+		~klotski_distributed();
+
+	private:
+		enum message_type: std::uint8_t{
+			Hello,
+			Start,
+			States,
+			LayerEnd,
+			LayerDone,
+			Decision,
+			ParentRequest,
+			ParentResponse,
+			SearchEnd,
+			Shutdown
+		};
+
+		enum decision_type: std::uint8_t{
+			Continue,
+			Found,
+			Exhausted
+		};
+
+		struct peer{
+			int fd = -1;
+			std::vector<std::uint8_t> outbox;
+			std::size_t outbox_sent = 0;
+			std::vector<std::uint8_t> inbox;
+			std::vector<std::uint8_t> batch;
+			std::uint32_t batch_count = 0;
+		};
+
+		struct record_item;
+		struct partition;
+
+		klotski_distributed(int listen_fd, const std::vector<endpoint>& endpoints, int worker_id);
+		void connect_peers(int listen_fd, const std::vector<endpoint>& endpoints);
+		static int listen_on(const std::string& host, int port);
+
+		void send_message(int to, message_type type, const std::vector<std::uint8_t>& payload);
+		void flush_batch(int to);
+		void pump(bool block);
+		void handle_message(int from, message_type type, const std::uint8_t* payload, std::size_t size);
+
+		void begin_search(int width, int height, const std::vector<std::uint16_t>& cells);
+		bool run_layers();
+		void expand_layer();
+		void insert_state(const std::uint16_t* cells, const klotski_search_state<klotski_dynamic_geometry>& state, int direction);
+		int get_owner(std::uint64_t hash) const noexcept;
+
+		void encode_cells(const std::uint16_t* cells, std::vector<std::uint8_t>& out) const;
+		void decode_cells(const std::uint8_t* in, std::uint16_t* cells) const;
+		int get_cell_bytes() const noexcept;
+
+		int worker_id;
+		std::vector<peer> peers;
+		std::vector<pid_t> children;
+		bool is_shutdown = false;
+
+		std::unique_ptr<partition> current;
+		int layer_end_count = 0;
+		int layer_done_count = 0;
+		std::uint64_t layer_next_states = 0;
+		bool layer_found = false;
+		int decision = -1;
+		int parent_response = -1;
+		bool is_search_over = false;
+		bool is_start_pending = false;
+		std::uint64_t last_states = 0;
+		int last_layers = 0;
+};
+
+#endif
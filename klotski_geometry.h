@@ -0,0 +1,306 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#ifndef KLOTSKI_GEOMETRY_H
+#define KLOTSKI_GEOMETRY_H
+
+#include "klotski_simd.h"
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// Moves of the blank, in the order the searches generate them.
+enum klotski_direction{
+	Left,
+	Right,
+	Up,
+	Down,
+	DirectionCount
+};
+
+// Transposing the board across its main diagonal swaps horizontal and
+// vertical moves.
+constexpr int klotski_mirror_direction(int direction) noexcept{
+	return direction < DirectionCount? direction ^ 2: direction;
+}
+
+namespace klotski_detail{
+	// Zobrist key of a tile on a cell. The blank has no key, so moving a tile
+	// changes the hash by the keys of that tile on its old and new cell.
+	constexpr std::uint64_t zobrist_key(int pos, int tile) noexcept{
+		if(tile == 0){
+			return 0;
+		}
+		std::uint64_t z = (static_cast<std::uint64_t>(pos) << 32 | static_cast<std::uint32_t>(tile)) + 0x9e3779b97f4a7c15ull;
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+
+	// Manhattan distance of a tile on a cell from its goal cell.
+	constexpr int tile_distance(int pos, int tile, int width) noexcept{
+		if(tile == 0){
+			return 0;
+		}
+		const int dx = pos % width - (tile - 1) % width;
+		const int dy = pos / width - (tile - 1) / width;
+		return (dx < 0? -dx: dx) + (dy < 0? -dy: dy);
+	}
+
+	template<int W, int H>
+		constexpr std::array<std::array<std::int8_t, DirectionCount>, W*H> make_neighbors() noexcept{
+			std::array<std::array<std::int8_t, DirectionCount>, W*H> neighbors{};
+			for(int pos=0; pos<W*H; ++pos){
+				const int x = pos % W;
+				const int y = pos / W;
+				neighbors[pos][Left] = x != 0? pos - 1: -1;
+				neighbors[pos][Right] = x != W - 1? pos + 1: -1;
+				neighbors[pos][Up] = y != 0? pos - W: -1;
+				neighbors[pos][Down] = y != H - 1? pos + W: -1;
+			}
+			return neighbors;
+		}
+
+	template<int W, int H>
+		constexpr std::array<std::uint8_t, W*H> make_goal() noexcept{
+			std::array<std::uint8_t, W*H> goal{};
+			for(int pos=0; pos<W*H-1; ++pos){
+				goal[pos] = static_cast<std::uint8_t>(pos + 1);
+			}
+			goal[W*H-1] = 0;
+			return goal;
+		}
+
+	// A square board's goal is symmetric under transposition once the tiles
+	// are relabelled: the tile whose goal cell is (x, y) becomes the tile whose
+	// goal cell is (y, x).
+	constexpr int mirror_pos(int pos, int width) noexcept{
+		return pos % width * width + pos / width;
+	}
+
+	constexpr int mirror_tile(int tile, int width) noexcept{
+		return tile == 0? 0: mirror_pos(tile - 1, width) + 1;
+	}
+
+	template<int W, int H>
+		constexpr std::array<std::uint8_t, W*H> make_mirror() noexcept{
+			std::array<std::uint8_t, W*H> mirror{};
+			for(int pos=0; pos<W*H; ++pos){
+				mirror[pos] = static_cast<std::uint8_t>(W == H? mirror_pos(pos, W): pos);
+			}
+			return mirror;
+		}
+
+	template<int W, int H>
+		constexpr std::array<std::array<std::uint64_t, W*H>, W*H> make_zobrist() noexcept{
+			std::array<std::array<std::uint64_t, W*H>, W*H> keys{};
+			for(int pos=0; pos<W*H; ++pos){
+				for(int tile=0; tile<W*H; ++tile){
+					keys[pos][tile] = zobrist_key(pos, tile);
+				}
+			}
+			return keys;
+		}
+
+	template<int W, int H>
+		constexpr std::array<std::array<std::uint8_t, W*H>, W*H> make_distances() noexcept{
+			std::array<std::array<std::uint8_t, W*H>, W*H> distances{};
+			for(int pos=0; pos<W*H; ++pos){
+				for(int tile=0; tile<W*H; ++tile){
+					distances[pos][tile] = static_cast<std::uint8_t>(tile_distance(pos, tile, W));
+				}
+			}
+			return distances;
+		}
+}
+
+// Board shape known at compile time. Every table is constexpr so the
+// engines instantiated on it can unroll and inline successor generation.
+template<int W, int H>
+class klotski_fixed_geometry{
+	public:
+		static_assert(W >= 2 && H >= 2 && W*H <= 127, "unsupported fixed board size");
+		using cell_type = std::uint8_t;
+
+		static constexpr int width = W;
+		static constexpr int height = H;
+		static constexpr int size = W*H;
+
+		constexpr int get_width() const noexcept{
+			return W;
+		}
+
+		constexpr int get_height() const noexcept{
+			return H;
+		}
+
+		constexpr int get_size() const noexcept{
+			return W*H;
+		}
+
+		constexpr int neighbor(int pos, int direction) const noexcept{
+			return neighbors[pos][direction];
+		}
+
+		constexpr cell_type goal(int pos) const noexcept{
+			return goal_cells[pos];
+		}
+
+		const cell_type* get_goal() const noexcept{
+			return goal_cells.data();
+		}
+
+		constexpr std::uint64_t zobrist(int pos, int tile) const noexcept{
+			return zobrist_keys[pos][tile];
+		}
+
+		constexpr int distance(int pos, int tile) const noexcept{
+			return distances[pos][tile];
+		}
+
+		// Heuristic after each move out of a position: the tile on
+		// targets[i] slides into the blank at zero. The table is cheaper
+		// than a vector pass here.
+		void score_moves(const cell_type* cells, int zero, std::uint32_t heuristic,
+				const int* targets, int count, std::uint32_t* out) const noexcept{
+			for(int i=0; i<count; ++i){
+				const int tile = cells[targets[i]];
+				out[i] = heuristic - distances[targets[i]][tile] + distances[zero][tile];
+			}
+		}
+
+		constexpr bool is_square() const noexcept{
+			return W == H;
+		}
+
+		constexpr int mirror_pos(int pos) const noexcept{
+			return mirrors[pos];
+		}
+
+		constexpr int mirror_tile(int tile) const noexcept{
+			return tile == 0? 0: mirrors[tile - 1] + 1;
+		}
+
+		constexpr std::uint64_t mirror_zobrist(int pos, int tile) const noexcept{
+			return zobrist_keys[mirror_pos(pos)][mirror_tile(tile)];
+		}
+
+	private:
+		static constexpr std::array<std::array<std::int8_t, DirectionCount>, W*H> neighbors =
+			klotski_detail::make_neighbors<W, H>();
+		static constexpr std::array<cell_type, W*H> goal_cells = klotski_detail::make_goal<W, H>();
+		static constexpr std::array<std::array<std::uint64_t, W*H>, W*H> zobrist_keys =
+			klotski_detail::make_zobrist<W, H>();
+		static constexpr std::array<std::array<std::uint8_t, W*H>, W*H> distances =
+			klotski_detail::make_distances<W, H>();
+		static constexpr std::array<std::uint8_t, W*H> mirrors = klotski_detail::make_mirror<W, H>();
+};
+
+// Fallback for every board size without a fixed instantiation.
+class klotski_dynamic_geometry{
+	public:
+		using cell_type = std::uint16_t;
+
+		klotski_dynamic_geometry(int width, int height):
+			width(width), height(height),
+			neighbors(static_cast<size_t>(width) * height),
+			goal_cells(static_cast<size_t>(width) * height){
+				if(width < 1 || height < 1 || width * height > 0xffff){
+					throw std::invalid_argument("unsupported board size");
+				}
+				for(int pos=0; pos<width*height; ++pos){
+					const int x = pos % width;
+					const int y = pos / width;
+					neighbors[pos][Left] = x != 0? pos - 1: -1;
+					neighbors[pos][Right] = x != width - 1? pos + 1: -1;
+					neighbors[pos][Up] = y != 0? pos - width: -1;
+					neighbors[pos][Down] = y != height - 1? pos + width: -1;
+					goal_cells[pos] = static_cast<cell_type>(pos + 1);
+				}
+				goal_cells.back() = 0;
+			}
+
+		int get_width() const noexcept{
+			return width;
+		}
+
+		int get_height() const noexcept{
+			return height;
+		}
+
+		int get_size() const noexcept{
+			return width * height;
+		}
+
+		int neighbor(int pos, int direction) const noexcept{
+			return neighbors[pos][direction];
+		}
+
+		cell_type goal(int pos) const noexcept{
+			return goal_cells[pos];
+		}
+
+		const cell_type* get_goal() const noexcept{
+			return goal_cells.data();
+		}
+
+		std::uint64_t zobrist(int pos, int tile) const noexcept{
+			return klotski_detail::zobrist_key(pos, tile);
+		}
+
+		int distance(int pos, int tile) const noexcept{
+			return klotski_detail::tile_distance(pos, tile, width);
+		}
+
+		// As for the fixed boards, but with no table every distance takes
+		// two divisions, so the moves go to the vector kernel together.
+		void score_moves(const cell_type* cells, int zero, std::uint32_t heuristic,
+				const int* targets, int count, std::uint32_t* out) const noexcept{
+			klotski_simd::score_moves(cells, width, zero, heuristic, targets, count, out);
+		}
+
+		bool is_square() const noexcept{
+			return width == height;
+		}
+
+		int mirror_pos(int pos) const noexcept{
+			return klotski_detail::mirror_pos(pos, width);
+		}
+
+		int mirror_tile(int tile) const noexcept{
+			return klotski_detail::mirror_tile(tile, width);
+		}
+
+		std::uint64_t mirror_zobrist(int pos, int tile) const noexcept{
+			return klotski_detail::zobrist_key(mirror_pos(pos), mirror_tile(tile));
+		}
+
+	private:
+		int width;
+		int height;
+		std::vector<std::array<int, DirectionCount>> neighbors;
+		std::vector<cell_type> goal_cells;
+};
+
+// Sizes that get a dedicated instantiation: 2x2 through 5x5 and 2xN strips.
+#define KLOTSKI_FIXED_GEOMETRIES(X) \
+	X(2, 2) X(2, 3) X(2, 4) X(2, 5) \
+	X(3, 2) X(3, 3) X(3, 4) X(3, 5) \
+	X(4, 2) X(4, 3) X(4, 4) X(4, 5) \
+	X(5, 2) X(5, 3) X(5, 4) X(5, 5) \
+	X(2, 6) X(2, 7) X(2, 8) \
+	X(6, 2) X(7, 2) X(8, 2)
+
+#endif
@@ -0,0 +1,225 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#ifndef KLOTSKI_IDA_ENGINE_H
+#define KLOTSKI_IDA_ENGINE_H
+
+#include "klotski_move_pruner.h"
+#include "klotski_search_engine.h"
+#include "klotski_transposition.h"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Iterative-deepening A* on the Manhattan distance. Memory stays at one
+// path, the price being that positions are revisited along different paths;
+// the move pruner cuts the short cycles among them. With a transposition
+// table the bound proved for each position carries over to every later
+// visit, in this iteration and the next ones.
+template<typename Geometry>
+class klotski_ida_engine: public klotski_search_engine{
+	public:
+		using cell_type = typename Geometry::cell_type;
+
+		explicit klotski_ida_engine(Geometry geometry = Geometry(), const klotski_search_options& options = klotski_search_options()):
+			geometry(std::move(geometry)),
+			// A bound proved under the automaton holds only for the move
+			// sequences it let through, so the table keeps to undoing moves.
+			pruner(options.use_move_pruning && options.transposition_size == 0?
+					&klotski_move_pruner::get(this->geometry.get_width(), this->geometry.get_height()): nullptr),
+			transposition_size(options.transposition_size),
+			perimeter(options.perimeter_size != 0?
+					klotski_perimeter::get(this->geometry.get_width(), this->geometry.get_height(), options.perimeter_size, options.use_symmetry): nullptr){}
+
+		using klotski_search_engine::search;
+		bool search(const std::uint16_t* cells, klotski_arena& arena, route_type& route) override;
+
+	private:
+		static constexpr std::uint32_t unbounded = std::numeric_limits<std::uint32_t>::max();
+
+		// Smallest cost above bound met below state, or the cost of the goal
+		// once is_found is set. table is null when there is none.
+		std::uint32_t probe(klotski_transposition* table, const klotski_search_state<Geometry>& state, std::uint32_t depth,
+				std::uint32_t bound, int fsm, int last_direction);
+		// The entry move is part of the key: the search below a position
+		// never undoes it, so the bound only holds for the same move.
+		static std::uint64_t get_key(const klotski_search_state<Geometry>& state, int last_direction) noexcept{
+			return state.hash ^ 0x9e3779b97f4a7c15ull * static_cast<std::uint64_t>(last_direction + 1);
+		}
+
+		Geometry geometry;
+		const klotski_move_pruner* pruner;
+		std::size_t transposition_size;
+		std::shared_ptr<const klotski_perimeter> perimeter;
+		std::vector<cell_type> cells;
+		std::vector<std::uint8_t> directions;
+		bool is_found = false;
+};
+
+template<typename Geometry>
+bool klotski_ida_engine<Geometry>::search(const std::uint16_t* root_cells, klotski_arena& arena, route_type& route){
+	cells.assign(root_cells, root_cells + geometry.get_size());
+	const std::vector<cell_type> root(cells);
+	klotski_search_state<Geometry> state;
+	state.init(geometry, cells.data());
+	std::unique_ptr<klotski_transposition> table;
+	if(transposition_size != 0){
+		table = std::make_unique<klotski_transposition>(transposition_size, arena.get_resource());
+	}
+	if(perimeter != nullptr){
+		stats.perimeter_depth = perimeter->get_depth();
+		stats.perimeter_entries = perimeter->get_entries();
+	}
+	std::uint32_t bound = state.heuristic;
+	while(true){
+		is_found = false;
+		directions.clear();
+		const std::uint32_t next_bound = probe(table.get(), state, 0, bound, klotski_move_pruner::start(), DirectionCount);
+		if(table != nullptr){
+			table->next_age();
+			stats.transposition_capacity = table->get_capacity();
+			stats.transposition_entries = table->get_entries();
+			stats.transposition_hits = table->get_hits();
+		}
+		if(is_found){
+			stats.depth = static_cast<int>(bound);
+			profile(RoutePhase);
+			klotski_build_route(geometry, root.data(), directions, route);
+			return true;
+		}
+		if(next_bound == unbounded || is_cancelled()){
+			return false;
+		}
+		bound = next_bound;
+	}
+}
+
+template<typename Geometry>
+std::uint32_t klotski_ida_engine<Geometry>::probe(klotski_transposition* table, const klotski_search_state<Geometry>& state,
+		std::uint32_t depth, std::uint32_t bound, int fsm, int last_direction){
+	if(is_cancelled()){
+		return unbounded;
+	}
+	profile(HeuristicPhase);
+	const std::uint32_t cost = depth + state.heuristic;
+	if(cost > bound){
+		return cost;
+	}
+	if(state.heuristic == 0){
+		is_found = true;
+		return cost;
+	}
+	// On the perimeter the distance is exact and the rest of the route is
+	// known; off it the goal is more than its depth away, or out of reach
+	// when it holds every position that can get there.
+	if(perimeter != nullptr){
+		profile(VisitedPhase);
+		int distance;
+		int direction;
+		if(perimeter->find(state.hash, state.mirror_hash, distance, direction)){
+			const std::uint32_t exact = depth + static_cast<std::uint32_t>(distance);
+			if(exact > bound){
+				return exact;
+			}
+			profile(RoutePhase);
+			if(perimeter->append_suffix(geometry, cells.data(), directions)){
+				is_found = true;
+				return exact;
+			}
+		}else if(perimeter->is_complete()){
+			return unbounded;
+		}else{
+			const std::uint32_t beyond = depth + static_cast<std::uint32_t>(perimeter->get_depth()) + 1;
+			if(beyond > bound){
+				return beyond;
+			}
+		}
+	}
+	std::uint64_t key = 0;
+	if(table != nullptr){
+		profile(VisitedPhase);
+		key = get_key(state, last_direction);
+		const std::uint32_t known = depth + table->probe(key);
+		if(known > bound){
+			return known;
+		}
+	}
+	profile(SuccessorPhase);
+	++stats.states;
+	std::uint32_t next_bound = unbounded;
+	const int zero = state.zero;
+	int targets[DirectionCount];
+	int moves[DirectionCount];
+	int fsms[DirectionCount];
+	int count = 0;
+	for(int direction=0; direction<DirectionCount; ++direction){
+		const int target = geometry.neighbor(zero, direction);
+		if(target < 0){
+			continue;
+		}
+		int next_fsm = fsm;
+		if(pruner != nullptr){
+			next_fsm = pruner->next(fsm, direction);
+			if(next_fsm == klotski_move_pruner::pruned){
+				continue;
+			}
+		}else if(last_direction != DirectionCount && direction == (last_direction ^ 1)){
+			continue;
+		}
+		targets[count] = target;
+		moves[count] = direction;
+		fsms[count++] = next_fsm;
+	}
+	profile(HeuristicPhase);
+	std::uint32_t heuristics[DirectionCount];
+	state.score_moves(geometry, cells.data(), targets, count, heuristics);
+	for(int move=0; move<count; ++move){
+		// A child over the bound is settled by its score alone.
+		const std::uint32_t child_cost = depth + 1 + heuristics[move];
+		if(child_cost > bound){
+			next_bound = std::min(next_bound, child_cost);
+			continue;
+		}
+		profile(SuccessorPhase);
+		const int target = targets[move];
+		const int direction = moves[move];
+		const int next_fsm = fsms[move];
+		const cell_type tile = cells[target];
+		auto child = state;
+		child.heuristic = heuristics[move];
+		child.slide(geometry, target, tile);
+		cells[zero] = tile;
+		cells[target] = 0;
+		directions.push_back(static_cast<std::uint8_t>(direction));
+		const std::uint32_t child_bound = probe(table, child, depth + 1, bound, next_fsm, direction);
+		if(is_found){
+			return child_bound;
+		}
+		profile(SuccessorPhase);
+		directions.pop_back();
+		cells[target] = tile;
+		cells[zero] = 0;
+		next_bound = std::min(next_bound, child_bound);
+	}
+	if(table != nullptr){
+		profile(VisitedPhase);
+		table->store(key, next_bound - depth, bound - depth);
+	}
+	return next_bound;
+}
+
+#endif
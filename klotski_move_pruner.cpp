@@ -0,0 +1,218 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#include "klotski_move_pruner.h"
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace{
+	// Cells the blank covered, relative to where it started.
+	struct box_type{
+		int min_x = 0;
+		int max_x = 0;
+		int min_y = 0;
+		int max_y = 0;
+
+		bool contains(const box_type& other) const noexcept{
+			return min_x <= other.min_x && other.max_x <= max_x
+				&& min_y <= other.min_y && other.max_y <= max_y;
+		}
+	};
+
+	using position_key = std::pair<std::uint64_t, std::uint64_t>;
+
+	struct position_hash{
+		std::size_t operator()(const position_key& key) const noexcept{
+			return static_cast<std::size_t>(key.first);
+		}
+	};
+
+	constexpr int length_shift = 56;
+	constexpr std::uint64_t move_mask = (std::uint64_t(1) << length_shift) - 1;
+	constexpr int offset_x[DirectionCount] = {-1, 1, 0, 0};
+	constexpr int offset_y[DirectionCount] = {0, 0, -1, 1};
+}
+
+klotski_move_pruner::klotski_move_pruner(int width, int height, int depth){
+	compile(learn(width, height, depth));
+}
+
+const klotski_move_pruner& klotski_move_pruner::get(int width, int height){
+	static std::mutex mutex;
+	static std::map<std::pair<int, int>, std::unique_ptr<klotski_move_pruner>> pruners;
+	std::lock_guard<std::mutex> lock(mutex);
+	auto& pruner = pruners[std::make_pair(width, height)];
+	if(pruner == nullptr){
+		pruner = std::make_unique<klotski_move_pruner>(width, height);
+	}
+	return *pruner;
+}
+
+// Plays every move string on a board wide enough that no string of the
+// given length reaches its border, and names the resulting position by two
+// independent Zobrist hashes of the cells that changed. Strings are packed
+// two bits per move, the last move lowest, so a suffix is a mask away.
+std::vector<std::string> klotski_move_pruner::learn(int width, int height, int depth) const{
+	const int size = 2 * depth + 1;
+	const int center = depth * size + depth;
+	std::vector<int> cells(size * size);
+	for(int pos=0; pos<size*size; ++pos){
+		cells[pos] = pos + 1;
+	}
+	cells[center] = 0;
+
+	std::unordered_map<position_key, std::vector<box_type>, position_hash> positions;
+	std::unordered_set<std::uint64_t> duplicates;
+	std::deque<std::uint64_t> open{0};
+	positions[position_key()].push_back(box_type());
+	std::vector<int> path;
+	while(!open.empty()){
+		const std::uint64_t moves = open.front();
+		open.pop_front();
+		const int length = static_cast<int>(moves >> length_shift);
+		if(length == depth){
+			continue;
+		}
+		for(int direction=0; direction<DirectionCount; ++direction){
+			const std::uint64_t bits = (moves & move_mask) << 2 | direction;
+			const std::uint64_t next = bits | static_cast<std::uint64_t>(length + 1) << length_shift;
+			bool is_known = false;
+			for(int suffix=2; suffix<=length && !is_known; ++suffix){
+				is_known = duplicates.count((bits & ((std::uint64_t(1) << 2 * suffix) - 1))
+						| static_cast<std::uint64_t>(suffix) << length_shift) != 0;
+			}
+			if(is_known){
+				continue;
+			}
+
+			box_type box;
+			int x = 0;
+			int y = 0;
+			int zero = center;
+			path.assign(1, center);
+			for(int i=length; i>=0; --i){
+				const int move = static_cast<int>(bits >> 2 * i & 3);
+				x += offset_x[move];
+				y += offset_y[move];
+				box.min_x = std::min(box.min_x, x);
+				box.max_x = std::max(box.max_x, x);
+				box.min_y = std::min(box.min_y, y);
+				box.max_y = std::max(box.max_y, y);
+				const int target = (depth + y) * size + depth + x;
+				cells[zero] = cells[target];
+				cells[target] = 0;
+				zero = target;
+				path.push_back(target);
+			}
+			position_key key;
+			std::sort(path.begin(), path.end());
+			path.erase(std::unique(path.begin(), path.end()), path.end());
+			for(int pos: path){
+				const int original = pos == center? 0: pos + 1;
+				if(cells[pos] != original){
+					key.first ^= klotski_detail::zobrist_key(pos, cells[pos] + 1);
+					key.second ^= klotski_detail::zobrist_key(pos + size * size, cells[pos] + 1);
+				}
+				cells[pos] = original;
+			}
+			if(box.max_x - box.min_x >= width || box.max_y - box.min_y >= height){
+				continue;
+			}
+
+			auto& boxes = positions[key];
+			bool is_duplicate = false;
+			for(const auto& i: boxes){
+				is_duplicate = is_duplicate || box.contains(i);
+			}
+			if(is_duplicate){
+				duplicates.insert(next);
+				continue;
+			}
+			boxes.push_back(box);
+			open.push_back(next);
+		}
+	}
+
+	std::vector<std::string> strings;
+	for(std::uint64_t moves: duplicates){
+		const int length = static_cast<int>(moves >> length_shift);
+		std::string string;
+		for(int i=length-1; i>=0; --i){
+			string.push_back(static_cast<char>(moves >> 2 * i & 3));
+		}
+		strings.push_back(std::move(string));
+	}
+	return strings;
+}
+
+void klotski_move_pruner::compile(const std::vector<std::string>& duplicates){
+	std::vector<std::array<std::int32_t, DirectionCount>> next(1);
+	std::vector<bool> is_end(1, false);
+	next[0].fill(-1);
+	for(const auto& moves: duplicates){
+		int state = 0;
+		for(char move: moves){
+			if(next[state][move] < 0){
+				next[state][move] = static_cast<std::int32_t>(next.size());
+				next.emplace_back();
+				next.back().fill(-1);
+				is_end.push_back(false);
+			}
+			state = next[state][move];
+		}
+		is_end[state] = true;
+	}
+	patterns = duplicates.size();
+
+	// Breadth-first over the trie: fill the missing edges from the failure
+	// links, and mark a state dead when any of its suffixes is a duplicate.
+	std::vector<std::int32_t> fail(next.size(), 0);
+	std::deque<int> queue;
+	for(int direction=0; direction<DirectionCount; ++direction){
+		if(next[0][direction] < 0){
+			next[0][direction] = 0;
+		}else{
+			queue.push_back(next[0][direction]);
+		}
+	}
+	while(!queue.empty()){
+		const int state = queue.front();
+		queue.pop_front();
+		is_end[state] = is_end[state] || is_end[fail[state]];
+		for(int direction=0; direction<DirectionCount; ++direction){
+			const int child = next[state][direction];
+			if(child < 0){
+				next[state][direction] = next[fail[state]][direction];
+			}else{
+				fail[child] = next[fail[state]][direction];
+				queue.push_back(child);
+			}
+		}
+	}
+
+	transitions.resize(next.size() * DirectionCount);
+	for(std::size_t state=0; state<next.size(); ++state){
+		for(int direction=0; direction<DirectionCount; ++direction){
+			const int target = next[state][direction];
+			transitions[state * DirectionCount + direction] = is_end[target]? pruned: target;
+		}
+	}
+}
@@ -0,0 +1,69 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#ifndef KLOTSKI_MOVE_PRUNER_H
+#define KLOTSKI_MOVE_PRUNER_H
+
+#include "klotski_geometry.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Duplicate move-sequence pruning after Taylor and Korf. A breadth-first
+// search over strings of blank moves, up to a fixed length, finds every
+// string that ends in the same position as an earlier one (shorter, or as
+// long and smaller in generation order) whose blank stays within the box
+// the later string covers, so the earlier one is playable wherever the
+// later one is. The later strings are compiled into an Aho-Corasick
+// automaton; a depth-first search carries one automaton state and drops
+// any move that would complete such a string. Every position keeps an
+// optimal path that survives, so the searches stay admissible.
+class klotski_move_pruner
+{
+	public:
+		static constexpr int default_depth = 10;
+		static constexpr int pruned = -1;
+
+		klotski_move_pruner(int width, int height, int depth = default_depth);
+
+		// Learned once per board size and shared by every later search.
+		static const klotski_move_pruner& get(int width, int height);
+
+		static constexpr int start() noexcept{
+			return 0;
+		}
+
+		// State after the move, or pruned if the move closes a duplicate.
+		int next(int state, int direction) const noexcept{
+			return transitions[state * DirectionCount + direction];
+		}
+
+		std::size_t get_states() const noexcept{
+			return transitions.size() / DirectionCount;
+		}
+
+		std::size_t get_patterns() const noexcept{
+			return patterns;
+		}
+
+	private:
+		std::vector<std::string> learn(int width, int height, int depth) const;
+		void compile(const std::vector<std::string>& duplicates);
+
+		std::vector<std::int32_t> transitions;
+		std::size_t patterns = 0;
+};
+
+#endif
@@ -0,0 +1,147 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#include "klotski_perimeter.h"
+#include "klotski_geometry.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+klotski_perimeter::klotski_perimeter(int width, int height, std::size_t size, bool use_symmetry):
+	use_symmetry(use_symmetry && width == height){
+	std::size_t capacity = 1;
+	while(capacity * 2 <= size / (sizeof(std::uint64_t) + sizeof(std::uint8_t))){
+		capacity *= 2;
+	}
+	if(capacity < 2){
+		throw std::invalid_argument("perimeter size too small");
+	}
+	keys.assign(capacity, 0);
+	moves.assign(capacity, empty);
+	mask = capacity - 1;
+	const std::uint64_t max_entries = capacity / 2;
+
+	using cell_type = klotski_dynamic_geometry::cell_type;
+	const klotski_dynamic_geometry geometry(width, height);
+	const int n = geometry.get_size();
+	// A layer of the search: the cells of its positions back to back, and
+	// for each one its hashes, blank and the move that reached it.
+	struct node{
+		std::uint64_t hash;
+		std::uint64_t mirror_hash;
+		int zero;
+		int direction;
+	};
+	// The two layers in hand share another size bytes, so that the build
+	// takes at most twice what the table keeps.
+	const std::size_t max_nodes = size / (sizeof(node) + n * sizeof(cell_type));
+	std::vector<node> layer;
+	std::vector<node> next;
+	std::vector<cell_type> layer_cells(geometry.get_goal(), geometry.get_goal() + n);
+	std::vector<cell_type> next_cells;
+	std::uint64_t goal_hash = 0;
+	std::uint64_t goal_mirror_hash = 0;
+	for(int pos=0; pos<n; ++pos){
+		goal_hash ^= geometry.zobrist(pos, layer_cells[pos]);
+		if(this->use_symmetry){
+			goal_mirror_hash ^= geometry.mirror_zobrist(pos, layer_cells[pos]);
+		}
+	}
+	layer.push_back(node{goal_hash, goal_mirror_hash, n - 1, DirectionCount});
+	insert(goal_hash, goal_mirror_hash, 0, 0);
+
+	while(depth < max_depth){
+		next.clear();
+		next_cells.clear();
+		for(std::size_t i=0; i<layer.size(); ++i){
+			const node& from = layer[i];
+			const cell_type* cells = layer_cells.data() + i * n;
+			for(int direction=0; direction<DirectionCount; ++direction){
+				const int target = geometry.neighbor(from.zero, direction);
+				if(target < 0 || (from.direction != DirectionCount && direction == (from.direction ^ 1))){
+					continue;
+				}
+				if(entries == max_entries){
+					// The next layer does not fit; find() leaves out the part
+					// of it that did.
+					return;
+				}
+				const cell_type tile = cells[target];
+				const std::uint64_t hash = from.hash ^ geometry.zobrist(target, tile) ^ geometry.zobrist(from.zero, tile);
+				std::uint64_t mirror_hash = 0;
+				if(this->use_symmetry){
+					mirror_hash = from.mirror_hash ^ geometry.mirror_zobrist(target, tile) ^ geometry.mirror_zobrist(from.zero, tile);
+				}
+				// Undoing this move leads back towards the goal. The mirror
+				// image of a position in the table is left out, as its
+				// moves are the mirrored ones.
+				if(!insert(hash, mirror_hash, depth + 1, direction ^ 1)){
+					continue;
+				}
+				if(next.size() == next.capacity()){
+					const std::size_t room = max_nodes - std::min(max_nodes, layer.capacity());
+					const std::size_t capacity = std::min(std::max<std::size_t>(next.capacity() * 2, 64), room);
+					if(capacity <= next.size()){
+						// The next layer outgrows the budget, and as above
+						// find() leaves out the part of it that is in.
+						return;
+					}
+					next.reserve(capacity);
+					next_cells.reserve(capacity * n);
+				}
+				next.push_back(node{hash, mirror_hash, target, direction});
+				next_cells.insert(next_cells.end(), cells, cells + n);
+				cell_type* moved = next_cells.data() + next_cells.size() - n;
+				moved[from.zero] = tile;
+				moved[target] = 0;
+			}
+		}
+		if(next.empty()){
+			complete = true;
+			return;
+		}
+		++depth;
+		std::swap(layer, next);
+		std::swap(layer_cells, next_cells);
+	}
+}
+
+std::shared_ptr<const klotski_perimeter> klotski_perimeter::get(int width, int height, std::size_t size, bool use_symmetry){
+	static std::mutex mutex;
+	static std::map<std::tuple<int, int, std::size_t, bool>, std::shared_ptr<const klotski_perimeter>> perimeters;
+	std::lock_guard<std::mutex> lock(mutex);
+	auto& perimeter = perimeters[std::make_tuple(width, height, size, use_symmetry && width == height)];
+	if(perimeter == nullptr){
+		perimeter = std::make_shared<const klotski_perimeter>(width, height, size, use_symmetry);
+	}
+	return perimeter;
+}
+
+bool klotski_perimeter::insert(std::uint64_t hash, std::uint64_t mirror_hash, int distance, int direction) noexcept{
+	const bool is_mirrored = use_symmetry && mirror_hash < hash;
+	const std::uint64_t key = is_mirrored? mirror_hash: hash;
+	std::size_t i = key & mask;
+	for(; moves[i] != empty; i=(i+1)&mask){
+		if(keys[i] == key){
+			return false;
+		}
+	}
+	keys[i] = key;
+	moves[i] = static_cast<std::uint8_t>(distance << 2 | (is_mirrored? klotski_mirror_direction(direction): direction));
+	++entries;
+	return true;
+}
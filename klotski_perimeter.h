@@ -0,0 +1,157 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#ifndef KLOTSKI_PERIMETER_H
+#define KLOTSKI_PERIMETER_H
+
+#include "klotski_geometry.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Every position within get_depth() moves of the solved board, with its
+// exact distance and the blank's next move towards the goal, found by one
+// breadth-first search back from the goal. Positions are stored under
+// their whole key, the transposition-canonical one on square boards with
+// use_symmetry, in an open-addressing table that is kept at most half
+// full, with a byte beside each key for the distance and the move. The
+// table and the layers the search keeps on the way each take at most size
+// bytes, and the search stops short at the last layer that fit in both.
+class klotski_perimeter
+{
+	public:
+		klotski_perimeter(int width, int height, std::size_t size, bool use_symmetry);
+		klotski_perimeter(const klotski_perimeter&) = delete;
+		klotski_perimeter& operator=(const klotski_perimeter&) = delete;
+
+		// The perimeter of a board size, built on first use and kept for the
+		// rest of the process.
+		static std::shared_ptr<const klotski_perimeter> get(int width, int height, std::size_t size, bool use_symmetry);
+
+		// Distance and next move of the position with hash and mirror_hash,
+		// as klotski_search_state keeps them, false when it is more than
+		// get_depth() moves away.
+		bool find(std::uint64_t hash, std::uint64_t mirror_hash, int& distance, int& direction) const noexcept{
+			const bool is_mirrored = use_symmetry && mirror_hash < hash;
+			const std::uint64_t key = is_mirrored? mirror_hash: hash;
+			for(std::size_t i=key&mask; ; i=(i+1)&mask){
+				const std::uint8_t move = moves[i];
+				if(move == empty){
+					return false;
+				}
+				if(keys[i] == key){
+					distance = move >> 2;
+					// The move was stored for the canonical position.
+					direction = is_mirrored? klotski_mirror_direction(move & 3): move & 3;
+					return distance <= depth;
+				}
+			}
+		}
+
+		// Appends the moves from cells to the goal to directions; false, with
+		// directions as they were, when cells is not on the perimeter.
+		template<typename Geometry>
+		bool append_suffix(const Geometry& geometry, const typename Geometry::cell_type* cells,
+				std::vector<std::uint8_t>& directions) const;
+
+		// Positions further than this are all outside the table.
+		int get_depth() const noexcept{
+			return depth;
+		}
+
+		// Whether the search ran out of positions, so that the table holds
+		// every position that can reach the goal.
+		bool is_complete() const noexcept{
+			return complete;
+		}
+
+		std::uint64_t get_entries() const noexcept{
+			return entries;
+		}
+
+		std::uint64_t get_capacity() const noexcept{
+			return keys.size();
+		}
+
+	private:
+		// Distance and move share a byte, and the distance stays below 63
+		// so that a byte of all ones can mark an empty slot.
+		static constexpr int max_depth = 62;
+		static constexpr std::uint8_t empty = 0xff;
+
+		// False when the position is already in the table.
+		bool insert(std::uint64_t hash, std::uint64_t mirror_hash, int distance, int direction) noexcept;
+
+		bool use_symmetry;
+		std::vector<std::uint64_t> keys;
+		std::vector<std::uint8_t> moves;
+		std::size_t mask;
+		std::uint64_t entries = 0;
+		int depth = 0;
+		bool complete = false;
+};
+
+template<typename Geometry>
+bool klotski_perimeter::append_suffix(const Geometry& geometry, const typename Geometry::cell_type* cells,
+		std::vector<std::uint8_t>& directions) const{
+	using cell_type = typename Geometry::cell_type;
+	const int n = geometry.get_size();
+	std::vector<cell_type> position(cells, cells + n);
+	std::uint64_t hash = 0;
+	std::uint64_t mirror_hash = 0;
+	int zero = 0;
+	for(int pos=0; pos<n; ++pos){
+		hash ^= geometry.zobrist(pos, position[pos]);
+		if(use_symmetry){
+			mirror_hash ^= geometry.mirror_zobrist(pos, position[pos]);
+		}
+		if(position[pos] == 0){
+			zero = pos;
+		}
+	}
+	const std::size_t length = directions.size();
+	int distance;
+	int direction;
+	bool is_on = find(hash, mirror_hash, distance, direction);
+	// Follow the stored moves, checking that each one gets a move closer, so
+	// that a hash collision can not pass for a route.
+	while(is_on && distance != 0){
+		const int target = geometry.neighbor(zero, direction);
+		if(target < 0){
+			is_on = false;
+			break;
+		}
+		const cell_type tile = position[target];
+		hash ^= geometry.zobrist(target, tile) ^ geometry.zobrist(zero, tile);
+		if(use_symmetry){
+			mirror_hash ^= geometry.mirror_zobrist(target, tile) ^ geometry.mirror_zobrist(zero, tile);
+		}
+		position[zero] = tile;
+		position[target] = 0;
+		zero = target;
+		directions.push_back(static_cast<std::uint8_t>(direction));
+		const int last_distance = distance;
+		is_on = find(hash, mirror_hash, distance, direction) && distance == last_distance - 1;
+	}
+	for(int pos=0; pos<n && is_on; ++pos){
+		is_on = position[pos] == geometry.goal(pos);
+	}
+	if(!is_on){
+		directions.resize(length);
+	}
+	return is_on;
+}
+
+#endif
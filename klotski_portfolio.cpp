@@ -0,0 +1,198 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#include "klotski_portfolio.h"
+#include "klotski_arena.h"
+#include "klotski_perimeter.h"
+#include "klotski_search.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace{
+	const char* const strategy_names[klotski_portfolio::StrategyCount] = {
+		"bfs", "bidirectional", "ida", "ida+table"
+	};
+}
+
+std::shared_ptr<klotski_portfolio> klotski_portfolio::get_default(){
+	static std::shared_ptr<klotski_portfolio> portfolio = std::make_shared<klotski_portfolio>();
+	return portfolio;
+}
+
+const char* klotski_portfolio::get_strategy_name(int strategy) noexcept{
+	return strategy >= 0 && strategy < StrategyCount? strategy_names[strategy]: "none";
+}
+
+klotski_search_options klotski_portfolio::get_strategy_options(int strategy, const klotski_search_options& options){
+	klotski_search_options strategy_options;
+	strategy_options.use_symmetry = options.use_symmetry;
+	strategy_options.use_move_pruning = options.use_move_pruning;
+	strategy_options.perimeter_size = options.perimeter_size;
+	switch(strategy){
+		case BfsStrategy:
+			strategy_options.engine = BfsEngine;
+			break;
+		case BidirectionalStrategy:
+			strategy_options.engine = BidirectionalEngine;
+			break;
+		case IdaStrategy:
+			strategy_options.engine = IdaEngine;
+			break;
+		case IdaTableStrategy:
+			strategy_options.engine = IdaEngine;
+			strategy_options.transposition_size = options.transposition_size != 0? options.transposition_size: table_size;
+			break;
+	}
+	return strategy_options;
+}
+
+// The engine that has won at least three races in four for this kind of
+// board, or -1 for a full race.
+int klotski_portfolio::pick(const record_type& record) const noexcept{
+	if(record.races < min_races || record.queries % explore_period == 0){
+		return -1;
+	}
+	int best = 0;
+	for(int strategy=1; strategy<StrategyCount; ++strategy){
+		if(record.wins[strategy] > record.wins[best]){
+			best = strategy;
+		}
+	}
+	return record.wins[best] * 4 >= record.races * 3? best: -1;
+}
+
+bool klotski_portfolio::search(const klotski_board::situation_type& situation, const klotski_search_options& options,
+		std::size_t arena_size, klotski_search_engine::route_type& route, klotski_search_stats& stats){
+	if(options.bitstate_size != 0 || !options.checkpoint_path.empty() || !options.resume_path.empty()
+			|| options.use_profiling){
+		throw std::invalid_argument("portfolio: bitstate, checkpoints and profiling need a single engine");
+	}
+	std::lock_guard<std::mutex> search_lock(mutex);
+	const int height = static_cast<int>(situation.size());
+	const int width = static_cast<int>(situation[0].size());
+	int manhattan = 0;
+	for(int y=0; y<height; ++y){
+		for(int x=0; x<width; ++x){
+			const int tile = situation[y][x];
+			if(tile != 0){
+				manhattan += std::abs((tile - 1) % width - x) + std::abs((tile - 1) / width - y);
+			}
+		}
+	}
+	record_type& record = learned[std::make_tuple(width, height, manhattan / manhattan_bucket)];
+	const int picked = pick(record);
+	++record.queries;
+
+	// The perimeter can not be cancelled, so it is built before the clock
+	// starts and the engines find it cached.
+	std::shared_ptr<const klotski_perimeter> perimeter;
+	if(options.perimeter_size != 0){
+		perimeter = klotski_perimeter::get(width, height, options.perimeter_size, options.use_symmetry);
+	}
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.portfolio_deadline);
+
+	std::vector<int> strategies;
+	for(int strategy=0; strategy<StrategyCount; ++strategy){
+		if(picked < 0 || picked == strategy){
+			strategies.push_back(strategy);
+		}
+	}
+	bool is_failed = false;
+	int winner = race(strategies, situation, options, arena_size, deadline, route, stats, is_failed);
+	// The engine that kept winning failed on this board: the query counts
+	// as one race it lost, whatever the others make of it.
+	const bool is_fallback = picked >= 0 && is_failed;
+	if(is_fallback){
+		strategies.clear();
+		for(int strategy=0; strategy<StrategyCount; ++strategy){
+			strategies.push_back(strategy);
+		}
+		winner = race(strategies, situation, options, arena_size, deadline, route, stats, is_failed);
+	}
+	const bool is_raced = strategies.size() == StrategyCount && winner >= 0;
+	if(is_fallback || is_raced){
+		++record.races;
+	}
+	if(is_raced){
+		++record.wins[winner];
+	}
+	stats.portfolio_winner = winner;
+	stats.portfolio_raced = static_cast<int>(strategies.size());
+	return winner >= 0;
+}
+
+int klotski_portfolio::race(const std::vector<int>& strategies, const klotski_board::situation_type& situation,
+		const klotski_search_options& options, std::size_t arena_size, std::chrono::steady_clock::time_point deadline,
+		klotski_search_engine::route_type& route, klotski_search_stats& stats, bool& is_failed){
+	const int height = static_cast<int>(situation.size());
+	const int width = static_cast<int>(situation[0].size());
+	std::mutex race_mutex;
+	std::condition_variable race_done;
+	std::atomic<bool> cancel(false);
+	int winner = -1;
+	std::size_t finished = 0;
+	is_failed = false;
+	std::vector<std::thread> threads;
+	for(int strategy: strategies){
+		threads.emplace_back([&, strategy]{
+			klotski_search_engine::route_type strategy_route;
+			klotski_search_stats strategy_stats;
+			bool is_found = false;
+			bool is_thrown = false;
+			try{
+				// Every engine has an arena of the caller's size, dropped
+				// with the race.
+				klotski_arena arena(arena_size);
+				auto engine = klotski_search::make_engine(width, height, get_strategy_options(strategy, options));
+				engine->set_cancel(&cancel);
+				is_found = engine->search(situation, arena, strategy_route);
+				strategy_stats = engine->get_stats();
+			}catch(const std::exception&){
+				// Out of memory or the like: this engine just drops out.
+				is_thrown = true;
+			}
+			std::lock_guard<std::mutex> lock(race_mutex);
+			if(is_found && winner < 0){
+				winner = strategy;
+				route = std::move(strategy_route);
+				stats = strategy_stats;
+				cancel = true;
+			}
+			is_failed = is_failed || is_thrown;
+			++finished;
+			race_done.notify_all();
+		});
+	}
+	{
+		std::unique_lock<std::mutex> lock(race_mutex);
+		const auto is_over = [&]{
+			return winner >= 0 || finished == strategies.size();
+		};
+		if(options.portfolio_deadline > 0){
+			race_done.wait_until(lock, deadline, is_over);
+		}else{
+			race_done.wait(lock, is_over);
+		}
+		stats.is_deadline_passed = !is_over();
+		cancel = true;
+	}
+	for(auto& thread: threads){
+		thread.join();
+	}
+	return winner;
+}
@@ -0,0 +1,93 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#ifndef KLOTSKI_PORTFOLIO_H
+#define KLOTSKI_PORTFOLIO_H
+
+#include "klotski_board.h"
+#include "klotski_search_engine.h"
+#include "klotski_search_options.h"
+#include "klotski_search_stats.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+// Races several engines on their own threads and keeps the first answer;
+// every engine in the race is optimal, so the first answer is an optimal
+// one, and the others are cancelled. The winners are counted by board
+// size and Manhattan distance, and once one engine keeps winning for a
+// kind of board it runs alone, with a full race now and then to check
+// that it still should.
+class klotski_portfolio
+{
+	public:
+		enum strategy_type{
+			BfsStrategy,
+			BidirectionalStrategy,
+			IdaStrategy,
+			IdaTableStrategy,
+			StrategyCount
+		};
+
+		klotski_portfolio() = default;
+		klotski_portfolio(const klotski_portfolio&) = delete;
+		klotski_portfolio& operator=(const klotski_portfolio&) = delete;
+
+		// The portfolio searches share when none is given, so what it
+		// learns lasts the whole process.
+		static std::shared_ptr<klotski_portfolio> get_default();
+
+		// Searches run one at a time, every engine in an arena of arena_size
+		// bytes of its own; returns false when every engine failed or
+		// options.portfolio_deadline passed first. The deadline counts from
+		// the end of the perimeter build. Throws invalid_argument for the
+		// options only a single engine has: bitstate, checkpoints and
+		// profiling.
+		bool search(const klotski_board::situation_type& situation, const klotski_search_options& options,
+				std::size_t arena_size, klotski_search_engine::route_type& route, klotski_search_stats& stats);
+
+		static const char* get_strategy_name(int strategy) noexcept;
+
+	private:
+		// Races seen for one kind of board and how many each engine won.
+		struct record_type{
+			std::uint32_t races = 0;
+			std::uint32_t queries = 0;
+			std::uint32_t wins[StrategyCount] = {};
+		};
+
+		static constexpr std::uint32_t min_races = 8;
+		static constexpr std::uint32_t explore_period = 8;
+		static constexpr int manhattan_bucket = 8;
+		static constexpr std::size_t table_size = 32 * 1024 * 1024;
+
+		int pick(const record_type& record) const noexcept;
+		// Runs strategies until one finds the route, all of them are done or
+		// deadline passes; returns the winner or -1, with is_failed set when
+		// an engine threw and stats.is_deadline_passed when time ran out.
+		int race(const std::vector<int>& strategies, const klotski_board::situation_type& situation,
+				const klotski_search_options& options, std::size_t arena_size, std::chrono::steady_clock::time_point deadline,
+				klotski_search_engine::route_type& route, klotski_search_stats& stats, bool& is_failed);
+		static klotski_search_options get_strategy_options(int strategy, const klotski_search_options& options);
+
+		std::mutex mutex;
+		std::map<std::tuple<int, int, int>, record_type> learned;
+};
+
+#endif
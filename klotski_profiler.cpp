@@ -0,0 +1,258 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#include "klotski_profiler.h"
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace{
+	const char* const phase_names[PhaseCount] = {
+		"successor", "visited", "heuristic", "route", "other"
+	};
+
+	const char* const counter_names[CounterCount] = {
+		"cycles", "instructions", "cache-misses", "branch-misses", "dtlb-misses", "ns"
+	};
+
+	struct event_config{
+		std::uint32_t type;
+		std::uint64_t config;
+	};
+
+	const event_config events[NanosecondsCounter] = {
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+		{PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB
+			| PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16}
+	};
+
+	std::uint64_t get_nanoseconds() noexcept{
+		struct timespec ts;
+		::clock_gettime(CLOCK_MONOTONIC, &ts);
+		return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000u + static_cast<std::uint64_t>(ts.tv_nsec);
+	}
+
+#if defined(__x86_64__) || defined(__i386__)
+	// Count of a running event straight from the PMU, false when the event
+	// is not on a counter right now.
+	bool read_rdpmc(const perf_event_mmap_page* page, std::uint64_t& value) noexcept{
+		std::uint32_t seq;
+		do{
+			seq = page->lock;
+			__asm__ __volatile__("" ::: "memory");
+			const std::uint32_t index = page->index;
+			if(!page->cap_user_rdpmc || index == 0){
+				return false;
+			}
+			std::uint32_t low, high;
+			__asm__ __volatile__("rdpmc" : "=a"(low), "=d"(high) : "c"(index - 1));
+			const int shift = 64 - page->pmc_width;
+			const std::int64_t pmc = static_cast<std::int64_t>(static_cast<std::uint64_t>(high) << 32 | low) << shift >> shift;
+			value = static_cast<std::uint64_t>(page->offset + pmc);
+			__asm__ __volatile__("" ::: "memory");
+		}while(page->lock != seq);
+		return true;
+	}
+#else
+	bool read_rdpmc(const perf_event_mmap_page*, std::uint64_t&) noexcept{
+		return false;
+	}
+#endif
+}
+
+klotski_profile& klotski_profile::operator+=(const klotski_profile& other) noexcept{
+	for(int phase=0; phase<PhaseCount; ++phase){
+		for(int counter=0; counter<CounterCount; ++counter){
+			counts[phase][counter] += other.counts[phase][counter];
+		}
+	}
+	// A counter is only good in the sum if it was good in every search.
+	for(int counter=0; counter<CounterCount; ++counter){
+		is_available[counter] = searches == 0? other.is_available[counter]: is_available[counter] && other.is_available[counter];
+	}
+	searches += other.searches;
+	return *this;
+}
+
+void klotski_profile::print(std::ostream& os) const{
+	std::stringstream output_stream;
+	output_stream<<std::left<<std::setw(12)<<"phase"<<std::right;
+	for(int counter=0; counter<CounterCount; ++counter){
+		output_stream<<std::setw(16)<<counter_names[counter];
+	}
+	output_stream<<std::endl;
+	std::uint64_t totals[CounterCount] = {};
+	for(int phase=0; phase<=PhaseCount; ++phase){
+		const bool is_total = phase == PhaseCount;
+		output_stream<<std::left<<std::setw(12)<<(is_total? "total": phase_names[phase])<<std::right;
+		for(int counter=0; counter<CounterCount; ++counter){
+			if(!is_available[counter]){
+				output_stream<<std::setw(16)<<"-";
+			}else if(is_total){
+				output_stream<<std::setw(16)<<totals[counter];
+			}else{
+				output_stream<<std::setw(16)<<counts[phase][counter];
+				totals[counter] += counts[phase][counter];
+			}
+		}
+		output_stream<<std::endl;
+	}
+	os<<output_stream.str();
+}
+
+klotski_profiler& klotski_profiler::get(){
+	thread_local klotski_profiler profiler;
+	return profiler;
+}
+
+klotski_profiler::klotski_profiler(){
+	const long page_size = ::sysconf(_SC_PAGESIZE);
+	is_rdpmc = true;
+	for(int i=0; i<event_count; ++i){
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = events[i].type;
+		attr.config = events[i].config;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		fds[i] = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+		group_index[i] = -1;
+		if(fds[i] < 0){
+			continue;
+		}
+		if(leader < 0){
+			leader = fds[i];
+		}
+		group_index[i] = group_size++;
+		void* page = ::mmap(nullptr, page_size, PROT_READ, MAP_SHARED, fds[i], 0);
+		if(page == MAP_FAILED || !static_cast<const perf_event_mmap_page*>(page)->cap_user_rdpmc){
+			is_rdpmc = false;
+		}
+		if(page != MAP_FAILED){
+			pages[i] = page;
+		}
+	}
+	profile.is_available[NanosecondsCounter] = true;
+}
+
+klotski_profiler::~klotski_profiler(){
+	const long page_size = ::sysconf(_SC_PAGESIZE);
+	for(int i=0; i<event_count; ++i){
+		if(pages[i] != nullptr){
+			::munmap(pages[i], page_size);
+		}
+		if(fds[i] >= 0){
+			::close(fds[i]);
+		}
+	}
+}
+
+void klotski_profiler::read(std::uint64_t* values) noexcept{
+	values[NanosecondsCounter] = get_nanoseconds();
+	if(group_size == 0){
+		return;
+	}
+	if(is_rdpmc){
+		bool is_read = true;
+		for(int i=0; i<event_count && is_read; ++i){
+			if(fds[i] >= 0){
+				is_read = read_rdpmc(static_cast<const perf_event_mmap_page*>(pages[i]), values[i]);
+			}
+		}
+		if(is_read){
+			return;
+		}
+	}
+	// The group is off the PMU or rdpmc is not allowed: ask the kernel.
+	std::uint64_t enabled, running;
+	read_group(values, enabled, running);
+}
+
+bool klotski_profiler::read_group(std::uint64_t* values, std::uint64_t& enabled, std::uint64_t& running) noexcept{
+	// The number of events, the times the group was enabled and on the PMU,
+	// then the counts.
+	std::uint64_t buffer[3 + event_count];
+	if(group_size == 0 || ::read(leader, buffer, sizeof(std::uint64_t) * (3 + group_size)) <= 0){
+		return false;
+	}
+	enabled = buffer[1];
+	running = buffer[2];
+	if(values != nullptr){
+		for(int i=0; i<event_count; ++i){
+			if(group_index[i] >= 0){
+				values[i] = buffer[3 + group_index[i]];
+			}
+		}
+	}
+	return true;
+}
+
+void klotski_profiler::start() noexcept{
+	for(auto& phase_counts: profile.counts){
+		for(auto& count: phase_counts){
+			count = 0;
+		}
+	}
+	for(int i=0; i<event_count; ++i){
+		profile.is_available[i] = fds[i] >= 0;
+	}
+	profile.searches = 1;
+	if(!read_group(nullptr, start_enabled, start_running)){
+		start_enabled = start_running = 0;
+	}
+	phase = OtherPhase;
+	read(last);
+}
+
+void klotski_profiler::enter(klotski_phase next_phase) noexcept{
+	if(next_phase != phase){
+		switch_to(next_phase);
+	}
+}
+
+void klotski_profiler::stop() noexcept{
+	switch_to(-1);
+	// When the group shared the PMU with other events it missed part of the
+	// search, and the counts can not be split among the phases after the
+	// fact: leave them out rather than print numbers that are too low.
+	std::uint64_t enabled, running;
+	if(read_group(nullptr, enabled, running) && running - start_running < enabled - start_enabled){
+		for(int i=0; i<event_count; ++i){
+			profile.is_available[i] = false;
+		}
+	}
+}
+
+void klotski_profiler::switch_to(int next_phase) noexcept{
+	std::uint64_t now[CounterCount];
+	std::memcpy(now, last, sizeof(now));
+	read(now);
+	if(phase >= 0){
+		for(int counter=0; counter<CounterCount; ++counter){
+			profile.counts[phase][counter] += now[counter] - last[counter];
+		}
+	}
+	std::memcpy(last, now, sizeof(last));
+	phase = next_phase;
+}
@@ -0,0 +1,104 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#ifndef KLOTSKI_PROFILER_H
+#define KLOTSKI_PROFILER_H
+
+#include <cstdint>
+#include <iostream>
+
+enum klotski_phase{
+	SuccessorPhase,
+	VisitedPhase,
+	HeuristicPhase,
+	RoutePhase,
+	// Queue handling, checkpoints and the rest of the search loop.
+	OtherPhase,
+	PhaseCount
+};
+
+enum klotski_counter{
+	CyclesCounter,
+	InstructionsCounter,
+	CacheMissesCounter,
+	BranchMissesCounter,
+	DtlbMissesCounter,
+	// Wall clock, always there.
+	NanosecondsCounter,
+	CounterCount
+};
+
+// Counter totals of one search, or summed over many.
+struct klotski_profile{
+	std::uint64_t counts[PhaseCount][CounterCount] = {};
+	bool is_available[CounterCount] = {};
+	std::uint64_t searches = 0;
+
+	klotski_profile& operator+=(const klotski_profile& other) noexcept;
+	void print(std::ostream& os = std::cout) const;
+};
+
+// Hardware counters of the calling thread read through perf_event_open.
+// Every enter() closes the running phase and charges it what the counters
+// moved since the last one. Counters the kernel or the machine does not
+// offer are left out and only the clock is kept, and so are all of them
+// when the kernel had to multiplex the group during the search. The
+// counters are read in user space with rdpmc where the kernel allows it
+// and with one read of the whole event group otherwise.
+class klotski_profiler
+{
+	public:
+		// The profiler of the calling thread, opened on first use.
+		static klotski_profiler& get();
+		klotski_profiler(const klotski_profiler&) = delete;
+		klotski_profiler& operator=(const klotski_profiler&) = delete;
+
+		// Clears the profile and starts in OtherPhase.
+		void start() noexcept;
+		void enter(klotski_phase phase) noexcept;
+		void stop() noexcept;
+
+		const klotski_profile& get_profile() const noexcept{
+			return profile;
+		}
+
+		~klotski_profiler();
+
+	private:
+		static constexpr int event_count = NanosecondsCounter;
+
+		klotski_profiler();
+		void read(std::uint64_t* values) noexcept;
+		// One read of the whole group through the kernel; values may be null
+		// for just the times.
+		bool read_group(std::uint64_t* values, std::uint64_t& enabled, std::uint64_t& running) noexcept;
+		// Charges the running phase and moves on to next_phase, -1 for none.
+		void switch_to(int next_phase) noexcept;
+
+		int fds[event_count];
+		void* pages[event_count] = {};
+		// Position of each open event in the group read.
+		int group_index[event_count];
+		int leader = -1;
+		int group_size = 0;
+		bool is_rdpmc = false;
+		int phase = -1;
+		std::uint64_t last[CounterCount] = {};
+		// Times of the group at start(), to tell whether it was multiplexed.
+		std::uint64_t start_enabled = 0;
+		std::uint64_t start_running = 0;
+		klotski_profile profile;
+};
+
+#endif
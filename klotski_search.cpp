@@ -13,95 +13,95 @@
    limitations under the License.  */
 
 #include "klotski_search.h"
+#include "klotski_bidirectional_engine.h"
+#include "klotski_bitstate_engine.h"
+#include "klotski_ida_engine.h"
 #include <stdexcept>
-#include <stack>
 #include <tuple>
 
+klotski_search::klotski_search(const klotski_board& board, std::shared_ptr<klotski_arena> arena):
+	situation(board.get_situation()),
+	is_solved(board.is_win()),
+	arena(arena != nullptr? std::move(arena): std::make_shared<klotski_arena>()),
+	dx(board.get_dx() - 1), dy(board.get_dy() - 1){
+		situation.shrink_to_fit();
+		// Numbers the cells can not hold leave them empty, and the board
+		// invalid.
+		for(const auto& i: situation){
+			for(int j: i){
+				if(j < 0 || j > 0xffff){
+					cells.clear();
+					return;
+				}
+				cells.push_back(static_cast<std::uint16_t>(j));
+			}
+		}
+	}
+
 bool klotski_search::start_search() noexcept{
 	if(!is_situation_valid()){
 		return false;
 	}
-	if(klotski_board::is_win(situation)){
+	last_stats = klotski_search_stats();
+	last_error.clear();
+	if(is_solved){
 		last_route.clear();
 		last_route.push_back(situation);
 		return true;
 	}
-	std::queue<record_item> open;
-	std::stack<record_item> close;
-	std::unordered_map<klotski_board::situation_type, bool, klotski_board::situation_type_hash> situation_search_state;
-	open.push(record_item{situation, record_item::Undefined, nullptr});
-	situation_search_state[situation] = true;
-	while(!open.empty()){
-		auto situation_front = open.front();
-		open.pop();
-		close.push(situation_front);
-		auto zero_pos = get_zero_pos(situation_front.situation);
-		if(std::get<0>(zero_pos) != 0){
-			auto situation_tmp = situation_front;
-			situation_tmp.Orientation = record_item::Horizontal;
-			situation_tmp.prev = &close.top();
-			std::swap(situation_tmp.situation[std::get<1>(zero_pos)][std::get<0>(zero_pos)],
-					situation_tmp.situation[std::get<1>(zero_pos)][std::get<0>(zero_pos) - 1]);
-			if(!situation_search_state[situation_tmp.situation]){
-				open.push(situation_tmp);
-				situation_search_state[situation_tmp.situation] = true;
-				if(klotski_board::is_win(situation_tmp.situation)){
-					build_route(situation_tmp);
-					return true;
-				}
-			}
+	if(distributed != nullptr){
+		try{
+			return distributed->search(situation, last_route);
+		}catch(const std::exception& e){
+			last_error = e.what();
+			return false;
 		}
-		if(std::get<0>(zero_pos) < dx){
-			auto situation_tmp = situation_front;
-			situation_tmp.Orientation = record_item::Horizontal;
-			situation_tmp.prev = &close.top();
-			std::swap(situation_tmp.situation[std::get<1>(zero_pos)][std::get<0>(zero_pos)],
-					situation_tmp.situation[std::get<1>(zero_pos)][std::get<0>(zero_pos) + 1]);
-			if(!situation_search_state[situation_tmp.situation]){
-				open.push(situation_tmp);
-				situation_search_state[situation_tmp.situation] = true;
-				if(klotski_board::is_win(situation_tmp.situation)){
-					build_route(situation_tmp);
-					return true;
-				}
-			}
+	}
+	if(options.engine == PortfolioEngine){
+		try{
+			auto& shared = portfolio != nullptr? *portfolio: *klotski_portfolio::get_default();
+			return shared.search(situation, options, arena->get_initial_size(), last_route, last_stats);
+		}catch(const std::exception& e){
+			last_error = e.what();
+			return false;
 		}
-		if(std::get<1>(zero_pos) != 0){
-			auto situation_tmp = situation_front;
-			situation_tmp.Orientation = record_item::Vertical;
-			situation_tmp.prev = &close.top();
-			std::swap(situation_tmp.situation[std::get<1>(zero_pos)][std::get<0>(zero_pos)],
-					situation_tmp.situation[std::get<1>(zero_pos) - 1][std::get<0>(zero_pos)]);
-			if(!situation_search_state[situation_tmp.situation]){
-				open.push(situation_tmp);
-				situation_search_state[situation_tmp.situation] = true;
-				if(klotski_board::is_win(situation_tmp.situation)){
-					build_route(situation_tmp);
-					return true;
-				}
-			}
+	}
+	arena->reset();
+	try{
+		auto engine = make_engine(dx + 1, dy + 1, options);
+		klotski_profiler* profiler = nullptr;
+		if(options.use_profiling){
+			profiler = &klotski_profiler::get();
+			profiler->start();
+			engine->set_profiler(profiler);
 		}
-		if(std::get<1>(zero_pos) < dy){
-			auto situation_tmp = situation_front;
-			situation_tmp.Orientation = record_item::Vertical;
-			situation_tmp.prev = &close.top();
-			std::swap(situation_tmp.situation[std::get<1>(zero_pos)][std::get<0>(zero_pos)],
-					situation_tmp.situation[std::get<1>(zero_pos) + 1][std::get<0>(zero_pos)]);
-			if(!situation_search_state[situation_tmp.situation]){
-				open.push(situation_tmp);
-				situation_search_state[situation_tmp.situation] = true;
-				if(klotski_board::is_win(situation_tmp.situation)){
-					build_route(situation_tmp);
-					return true;
-				}
-			}
+		const bool is_found = engine->search(cells.data(), *arena, last_route);
+		last_stats = engine->get_stats();
+		if(profiler != nullptr){
+			profiler->stop();
+			last_stats.profile = profiler->get_profile();
 		}
+		return is_found;
+	}catch(const std::exception& e){
+		last_error = e.what();
+		return false;
+	}
+}
+
+std::unique_ptr<klotski_search_engine> klotski_search::make_engine(int width, int height, const klotski_search_options& options){
+	if(options.bitstate_size != 0){
+		return klotski_make_engine<klotski_bitstate_engine>(width, height, options);
+	}else if(options.engine == IdaEngine){
+		return klotski_make_engine<klotski_ida_engine>(width, height, options);
+	}else if(options.engine == BidirectionalEngine){
+		return klotski_make_engine<klotski_bidirectional_engine>(width, height, options);
 	}
-	return false;
+	return klotski_make_engine<klotski_bfs_engine>(width, height, options);
 }
 
 bool klotski_search::is_situation_valid() const noexcept{
-	return klotski_board::is_valid(situation, dx + 1, dy + 1);
+	return cells.size() == static_cast<std::size_t>(dx + 1) * (dy + 1)
+		&& klotski_board::is_valid(cells.data(), dx + 1, dy + 1);
 }
 
 std::tuple<int, int> klotski_search::get_zero_pos(const klotski_board::situation_type& situation_cur) const{
@@ -117,17 +117,3 @@ std::tuple<int, int> klotski_search::get_zero_pos(const klotski_board::situation
 	}
 	throw std::runtime_error("can not find zero");
 }
-
-void klotski_search::build_route(const record_item& item){
-	const record_item* cur_item = &item;
-	last_route.clear();
-	auto last_orientation = record_item::Undefined;
-	while(cur_item != nullptr){
-		if(cur_item->Orientation != last_orientation){
-			last_route.push_front(cur_item->situation);
-			last_orientation = cur_item->Orientation;
-		}
-		cur_item = cur_item->prev;
-	}
-}
-
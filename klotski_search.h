@@ -16,30 +16,25 @@
 #define KLOTSKI_SEARCH_H
 
 #include "klotski_board.h"
-#include <unordered_map>
+#include "klotski_arena.h"
+#include "klotski_distributed.h"
+#include "klotski_portfolio.h"
+#include "klotski_search_engine.h"
+#include "klotski_search_options.h"
+#include "klotski_search_stats.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <string>
 #include <tuple>
-#include <queue>
+#include <vector>
 
 class klotski_search{
 	public:
-		explicit klotski_search(const klotski_board& board):
-			situation(board.get_situation()),
-			dx(board.get_dx() - 1), dy(board.get_dy() - 1){
-				situation.shrink_to_fit();
-			}
-		explicit klotski_search(std::shared_ptr<klotski_board> board_ptr):
-			klotski_search(*board_ptr){};
-
-		struct record_item{
-			klotski_board::situation_type situation;
-			enum{
-				Horizontal,
-				Vertical,
-				Undefined
-			} Orientation;
-			struct record_item* prev;
-		};
+		explicit klotski_search(const klotski_board& board, std::shared_ptr<klotski_arena> arena = nullptr);
+		explicit klotski_search(std::shared_ptr<klotski_board> board_ptr, std::shared_ptr<klotski_arena> arena = nullptr):
+			klotski_search(*board_ptr, std::move(arena)){};
 
 		virtual bool start_search() noexcept;
 		virtual bool is_situation_valid() const noexcept;
@@ -47,15 +42,52 @@ class klotski_search{
 		const std::deque<klotski_board::situation_type>& get_last_route() const noexcept{
 			return last_route;
 		}
+		const klotski_arena& get_arena() const noexcept{
+			return *arena;
+		}
+		const klotski_search_stats& get_last_stats() const noexcept{
+			return last_stats;
+		}
+		// Why the last search failed, as opposed to finding no route; empty
+		// when it ran to either end.
+		const std::string& get_last_error() const noexcept{
+			return last_error;
+		}
+		const klotski_search_options& get_options() const noexcept{
+			return options;
+		}
+		void set_options(const klotski_search_options& search_options) noexcept{
+			options = search_options;
+		}
+		// Hand the search to a group of worker processes instead of running
+		// it in this one.
+		void set_distributed(std::shared_ptr<klotski_distributed> group) noexcept{
+			distributed = std::move(group);
+		}
+		// The portfolio to learn in for PortfolioEngine, the process-wide one
+		// when none is set.
+		void set_portfolio(std::shared_ptr<klotski_portfolio> shared_portfolio) noexcept{
+			portfolio = std::move(shared_portfolio);
+		}
+		// A single engine for options.engine; not for PortfolioEngine.
+		static std::unique_ptr<klotski_search_engine> make_engine(int width, int height, const klotski_search_options& options);
 
-	private:
-		void build_route(const record_item& item);
+		virtual ~klotski_search() = default;
 
+	private:
 		klotski_board::situation_type situation;
+		// The same position as the engines take it.
+		std::vector<std::uint16_t> cells;
+		bool is_solved;
 		std::deque<klotski_board::situation_type> last_route;
+		klotski_search_stats last_stats;
+		std::string last_error;
+		std::shared_ptr<klotski_arena> arena;
+		klotski_search_options options;
+		std::shared_ptr<klotski_distributed> distributed;
+		std::shared_ptr<klotski_portfolio> portfolio;
 		int dx;
 		int dy;
 };
 
 #endif
-
@@ -0,0 +1,566 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#ifndef KLOTSKI_SEARCH_ENGINE_H
+#define KLOTSKI_SEARCH_ENGINE_H
+
+#include "klotski_arena.h"
+#include "klotski_board.h"
+#include "klotski_checkpoint.h"
+#include "klotski_geometry.h"
+#include "klotski_perimeter.h"
+#include "klotski_profiler.h"
+#include "klotski_search_options.h"
+#include "klotski_search_stats.h"
+#include "klotski_simd.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+class klotski_search_engine{
+	public:
+		using route_type = std::deque<klotski_board::situation_type>;
+
+		// Searches from the position with cells row by row, 0 for the blank.
+		virtual bool search(const std::uint16_t* cells, klotski_arena& arena, route_type& route) = 0;
+		// The same from the rows of a board.
+		bool search(const klotski_board::situation_type& situation, klotski_arena& arena, route_type& route){
+			std::vector<std::uint16_t> cells;
+			for(const auto& i: situation){
+				cells.insert(cells.end(), i.begin(), i.end());
+			}
+			return search(cells.data(), arena, route);
+		}
+		const klotski_search_stats& get_stats() const noexcept{
+			return stats;
+		}
+		// Charge the phases of the next searches to profiler.
+		void set_profiler(klotski_profiler* search_profiler) noexcept{
+			profiler = search_profiler;
+		}
+		// Once flag is set the search gives up and returns false.
+		void set_cancel(const std::atomic<bool>* flag) noexcept{
+			cancel = flag;
+		}
+		virtual ~klotski_search_engine() = default;
+
+	protected:
+		void profile(klotski_phase phase) noexcept{
+			if(profiler != nullptr){
+				profiler->enter(phase);
+			}
+		}
+
+		bool is_cancelled() const noexcept{
+			return cancel != nullptr && cancel->load(std::memory_order_relaxed);
+		}
+
+		klotski_search_stats stats;
+		klotski_profiler* profiler = nullptr;
+		const std::atomic<bool>* cancel = nullptr;
+};
+
+// Hash and heuristic of a position, kept up to date in O(1) per move from
+// the tile that slid into the blank. On square boards the hash of the
+// transposed position is tracked as well, so that a position and its
+// mirror image share one canonical key.
+template<typename Geometry>
+struct klotski_search_state{
+	using cell_type = typename Geometry::cell_type;
+
+	std::uint64_t hash;
+	std::uint64_t mirror_hash;
+	std::uint32_t heuristic;
+	std::uint16_t zero;
+
+	void init(const Geometry& geometry, const cell_type* cells) noexcept{
+		hash = 0;
+		mirror_hash = 0;
+		for(int pos=0; pos<geometry.get_size(); ++pos){
+			hash ^= geometry.zobrist(pos, cells[pos]);
+			if(geometry.is_square()){
+				mirror_hash ^= geometry.mirror_zobrist(pos, cells[pos]);
+			}
+		}
+		heuristic = klotski_simd::manhattan(cells, geometry.get_size(), geometry.get_width());
+		zero = static_cast<std::uint16_t>(klotski_simd::find(cells, geometry.get_size(), cell_type(0)));
+	}
+
+	void move(const Geometry& geometry, int target, int tile) noexcept{
+		update_heuristic(geometry, target, tile);
+		slide(geometry, target, tile);
+	}
+
+	// Heuristic after each of the count moves that slide the tile on
+	// targets[i] into the blank, scored as one batch.
+	void score_moves(const Geometry& geometry, const cell_type* cells, const int* targets, int count,
+			std::uint32_t* out) const noexcept{
+		geometry.score_moves(cells, zero, heuristic, targets, count, out);
+	}
+
+	// The two halves of move, apart for profiling; the heuristic goes
+	// first as it needs the old blank.
+	void update_heuristic(const Geometry& geometry, int target, int tile) noexcept{
+		heuristic = heuristic - geometry.distance(target, tile) + geometry.distance(zero, tile);
+	}
+
+	void slide(const Geometry& geometry, int target, int tile) noexcept{
+		hash ^= geometry.zobrist(target, tile) ^ geometry.zobrist(zero, tile);
+		if(geometry.is_square()){
+			mirror_hash ^= geometry.mirror_zobrist(target, tile) ^ geometry.mirror_zobrist(zero, tile);
+		}
+		zero = static_cast<std::uint16_t>(target);
+	}
+
+	std::uint64_t get_key(bool use_symmetry) const noexcept{
+		return use_symmetry && mirror_hash < hash? mirror_hash: hash;
+	}
+};
+
+// Whether a is b transposed across the main diagonal.
+template<typename Geometry>
+bool klotski_is_mirror(const Geometry& geometry, const typename Geometry::cell_type* a,
+		const typename Geometry::cell_type* b) noexcept{
+	for(int pos=0; pos<geometry.get_size(); ++pos){
+		if(a[pos] != geometry.mirror_tile(b[geometry.mirror_pos(pos)])){
+			return false;
+		}
+	}
+	return true;
+}
+
+// Plays directions from root and keeps the root, the goal and every
+// position where the move orientation changes, the route format of every
+// engine.
+template<typename Geometry>
+void klotski_build_route(const Geometry& geometry, const typename Geometry::cell_type* root,
+		const std::vector<std::uint8_t>& directions, klotski_search_engine::route_type& route){
+	using cell_type = typename Geometry::cell_type;
+	const int n = geometry.get_size();
+	std::vector<cell_type> positions((directions.size() + 1) * n);
+	std::copy(root, root + n, positions.begin());
+	for(std::size_t i=0; i<directions.size(); ++i){
+		const cell_type* cells = positions.data() + i * n;
+		cell_type* next = positions.data() + (i + 1) * n;
+		const int zero = static_cast<int>(std::find(cells, cells + n, cell_type(0)) - cells);
+		const int target = geometry.neighbor(zero, directions[i]);
+		std::copy(cells, cells + n, next);
+		next[zero] = cells[target];
+		next[target] = 0;
+	}
+	route.clear();
+	bool last_horizontal = false;
+	for(std::size_t i=directions.size()+1; i-->0;){
+		const bool is_horizontal = i != 0 && (directions[i - 1] == Left || directions[i - 1] == Right);
+		if(i == directions.size() || i == 0 || is_horizontal != last_horizontal){
+			klotski_board::situation_type situation_cur(geometry.get_height(), std::vector<int>(geometry.get_width()));
+			const cell_type* cell = positions.data() + i * n;
+			for(auto& row: situation_cur){
+				for(int& j: row){
+					j = *cell++;
+				}
+			}
+			route.push_front(std::move(situation_cur));
+			last_horizontal = is_horizontal;
+		}
+	}
+}
+
+template<typename Geometry>
+class klotski_bfs_engine: public klotski_search_engine{
+	public:
+		using cell_type = typename Geometry::cell_type;
+
+		explicit klotski_bfs_engine(Geometry geometry = Geometry(), const klotski_search_options& options = klotski_search_options()):
+			geometry(std::move(geometry)),
+			use_symmetry(options.use_symmetry && this->geometry.is_square()),
+			checkpoint_path(options.checkpoint_path),
+			checkpoint_interval(options.checkpoint_interval),
+			resume_path(options.resume_path),
+			perimeter(options.perimeter_size != 0?
+					klotski_perimeter::get(this->geometry.get_width(), this->geometry.get_height(), options.perimeter_size, options.use_symmetry): nullptr){}
+
+		using klotski_search_engine::search;
+		bool search(const std::uint16_t* cells, klotski_arena& arena, route_type& route) override;
+
+	private:
+		struct record_item{
+			const record_item* prev;
+			klotski_search_state<Geometry> state;
+			std::uint8_t direction;
+			// Position in the order of discovery, for checkpoints.
+			std::uint32_t index;
+
+			cell_type* cells() noexcept{
+				return reinterpret_cast<cell_type*>(this + 1);
+			}
+
+			const cell_type* cells() const noexcept{
+				return reinterpret_cast<const cell_type*>(this + 1);
+			}
+		};
+
+		class record_hash{
+			public:
+				explicit record_hash(bool use_symmetry) noexcept: use_symmetry(use_symmetry){}
+				size_t operator()(const record_item* item) const noexcept{
+					return static_cast<size_t>(item->state.get_key(use_symmetry));
+				}
+			private:
+				bool use_symmetry;
+		};
+
+		class record_equal{
+			public:
+				record_equal(const Geometry& geometry, bool use_symmetry) noexcept:
+					geometry(&geometry), use_symmetry(use_symmetry){}
+				bool operator()(const record_item* a, const record_item* b) const noexcept{
+					if(a->state.get_key(use_symmetry) != b->state.get_key(use_symmetry)){
+						return false;
+					}
+					return std::memcmp(a->cells(), b->cells(), geometry->get_size() * sizeof(cell_type)) == 0
+						|| (use_symmetry && klotski_is_mirror(*geometry, a->cells(), b->cells()));
+				}
+			private:
+				const Geometry* geometry;
+				bool use_symmetry;
+		};
+
+		using record_set = std::pmr::unordered_set<const record_item*, record_hash, record_equal>;
+		using record_list = std::pmr::vector<const record_item*>;
+
+		record_item* new_record(std::pmr::memory_resource* resource) const;
+		void build_route(const record_item& item, route_type& route) const;
+		// Moves from the root to item.
+		static int get_depth(const record_item& item) noexcept;
+		// Ends the search at item when it is on the perimeter.
+		bool finish_on_perimeter(const record_item& item, route_type& route);
+		bool is_resumable(const klotski_checkpoint_header& header, const record_item& root) const noexcept;
+		void load_checkpoint(const klotski_checkpoint_reader& reader, record_list& records,
+				record_set& visited, std::pmr::memory_resource* resource) const;
+		void save_checkpoint(klotski_checkpoint_writer& writer, const record_list& records, std::uint64_t expanded) const;
+
+		Geometry geometry;
+		bool use_symmetry;
+		std::string checkpoint_path;
+		std::chrono::seconds checkpoint_interval;
+		std::string resume_path;
+		std::shared_ptr<const klotski_perimeter> perimeter;
+};
+
+template<typename Geometry>
+bool klotski_bfs_engine<Geometry>::search(const std::uint16_t* root_cells, klotski_arena& arena, route_type& route){
+	const int n = geometry.get_size();
+	auto* resource = arena.get_resource();
+	std::pmr::deque<const record_item*> open(resource);
+	record_set situation_search_state(1024, record_hash(use_symmetry), record_equal(geometry, use_symmetry), resource);
+	// Every position in the order it was found, kept only for checkpoints.
+	record_list records(resource);
+
+	auto* root = new_record(resource);
+	root->prev = nullptr;
+	root->direction = DirectionCount;
+	root->index = 0;
+	std::copy(root_cells, root_cells + n, root->cells());
+	root->state.init(geometry, root->cells());
+	if(root->state.heuristic == 0){
+		profile(RoutePhase);
+		build_route(*root, route);
+		return true;
+	}
+	situation_search_state.insert(root);
+	records.push_back(root);
+
+	std::uint64_t expanded = 0;
+	bool is_resumed = false;
+	if(!resume_path.empty()){
+		klotski_checkpoint_reader reader(resume_path);
+		if(is_resumable(reader.get_header(), *root)){
+			load_checkpoint(reader, records, situation_search_state, resource);
+			expanded = reader.get_header().expanded;
+			is_resumed = true;
+		}
+	}
+	if(perimeter != nullptr){
+		stats.perimeter_depth = perimeter->get_depth();
+		stats.perimeter_entries = perimeter->get_entries();
+		// In the order of discovery, so the first one found is the closest.
+		profile(VisitedPhase);
+		for(const record_item* item: records){
+			if(finish_on_perimeter(*item, route)){
+				stats.states = situation_search_state.size();
+				return true;
+			}
+		}
+	}
+	for(auto it=records.begin()+expanded; it!=records.end(); ++it){
+		open.push_back(*it);
+	}
+	// Positions come in layer order, so the last one found is the deepest.
+	const record_item* deepest = records.back();
+	const bool keep_records = !checkpoint_path.empty();
+	if(!keep_records){
+		records.clear();
+		records.shrink_to_fit();
+	}
+
+	std::unique_ptr<klotski_checkpoint_writer> writer;
+	if(keep_records){
+		klotski_checkpoint_header header;
+		header.width = geometry.get_width();
+		header.height = geometry.get_height();
+		header.use_symmetry = use_symmetry;
+		header.records = 1;
+		header.root.assign(root->cells(), root->cells() + n);
+		if(is_resumed && checkpoint_path == resume_path){
+			header.records = records.size();
+			writer = std::make_unique<klotski_checkpoint_writer>(checkpoint_path, header, true);
+		}else{
+			writer = std::make_unique<klotski_checkpoint_writer>(checkpoint_path, header);
+		}
+	}
+	auto last_checkpoint = std::chrono::steady_clock::now();
+
+	record_item* spare = nullptr;
+	while(!open.empty()){
+		if(writer != nullptr && (expanded & 4095) == 0
+				&& std::chrono::steady_clock::now() - last_checkpoint >= checkpoint_interval){
+			save_checkpoint(*writer, records, expanded);
+			last_checkpoint = std::chrono::steady_clock::now();
+		}
+		if(is_cancelled()){
+			break;
+		}
+		const record_item* situation_front = open.front();
+		open.pop_front();
+		++expanded;
+		const int zero = situation_front->state.zero;
+		int targets[DirectionCount];
+		int moves[DirectionCount];
+		int count = 0;
+		for(int direction=0; direction<DirectionCount; ++direction){
+			const int target = geometry.neighbor(zero, direction);
+			// Undoing the last move only leads back to the parent.
+			if(target >= 0 && (situation_front->direction == DirectionCount || direction != (situation_front->direction ^ 1))){
+				targets[count] = target;
+				moves[count++] = direction;
+			}
+		}
+		profile(HeuristicPhase);
+		std::uint32_t heuristics[DirectionCount];
+		situation_front->state.score_moves(geometry, situation_front->cells(), targets, count, heuristics);
+		for(int move=0; move<count; ++move){
+			profile(SuccessorPhase);
+			const int target = targets[move];
+			const int direction = moves[move];
+			if(spare == nullptr){
+				spare = new_record(resource);
+			}
+			const cell_type tile = situation_front->cells()[target];
+			spare->state = situation_front->state;
+			spare->state.heuristic = heuristics[move];
+			spare->state.slide(geometry, target, tile);
+			cell_type* cells = spare->cells();
+			std::memcpy(cells, situation_front->cells(), n * sizeof(cell_type));
+			cells[zero] = tile;
+			cells[target] = 0;
+			profile(VisitedPhase);
+			const bool is_new = situation_search_state.insert(spare).second;
+			profile(OtherPhase);
+			if(!is_new){
+				continue;
+			}
+			spare->prev = situation_front;
+			spare->direction = static_cast<std::uint8_t>(direction);
+			spare->index = static_cast<std::uint32_t>(situation_search_state.size() - 1);
+			open.push_back(spare);
+			deepest = spare;
+			if(keep_records){
+				records.push_back(spare);
+			}
+			const record_item* child = spare;
+			spare = nullptr;
+			if(child->state.heuristic == 0){
+				stats.states = situation_search_state.size();
+				stats.depth = get_depth(*child);
+				profile(RoutePhase);
+				build_route(*child, route);
+				return true;
+			}
+			// The first position found on the perimeter is in the shallowest
+			// layer that reaches it, and sits on its edge, so the route
+			// through it is a shortest one.
+			if(perimeter != nullptr){
+				profile(VisitedPhase);
+				if(finish_on_perimeter(*child, route)){
+					stats.states = situation_search_state.size();
+					return true;
+				}
+				profile(OtherPhase);
+			}
+		}
+	}
+	stats.states = situation_search_state.size();
+	stats.depth = get_depth(*deepest);
+	return false;
+}
+
+template<typename Geometry>
+int klotski_bfs_engine<Geometry>::get_depth(const record_item& item) noexcept{
+	int depth = 0;
+	for(const record_item* cur_item=&item; cur_item->prev!=nullptr; cur_item=cur_item->prev){
+		++depth;
+	}
+	return depth;
+}
+
+template<typename Geometry>
+bool klotski_bfs_engine<Geometry>::finish_on_perimeter(const record_item& item, route_type& route){
+	int distance;
+	int direction;
+	if(!perimeter->find(item.state.hash, item.state.mirror_hash, distance, direction)){
+		return false;
+	}
+	profile(RoutePhase);
+	std::vector<std::uint8_t> directions;
+	const record_item* root = &item;
+	for(; root->prev != nullptr; root = root->prev){
+		directions.push_back(root->direction);
+	}
+	std::reverse(directions.begin(), directions.end());
+	if(!perimeter->append_suffix(geometry, item.cells(), directions)){
+		return false;
+	}
+	stats.depth = static_cast<int>(directions.size());
+	klotski_build_route(geometry, root->cells(), directions, route);
+	return true;
+}
+
+template<typename Geometry>
+bool klotski_bfs_engine<Geometry>::is_resumable(const klotski_checkpoint_header& header, const record_item& root) const noexcept{
+	if(header.width != geometry.get_width() || header.height != geometry.get_height()
+			|| header.use_symmetry != use_symmetry){
+		return false;
+	}
+	for(int pos=0; pos<geometry.get_size(); ++pos){
+		if(header.root[pos] != root.cells()[pos]){
+			return false;
+		}
+	}
+	return true;
+}
+
+// Replays every stored move from its parent, which also brings the hash and
+// heuristic back in O(1) per position.
+template<typename Geometry>
+void klotski_bfs_engine<Geometry>::load_checkpoint(const klotski_checkpoint_reader& reader, record_list& records,
+		record_set& visited, std::pmr::memory_resource* resource) const{
+	const int n = geometry.get_size();
+	const std::uint64_t count = reader.get_header().records;
+	records.reserve(count);
+	visited.reserve(count);
+	for(std::uint64_t i=1; i<count; ++i){
+		const std::uint32_t parent_index = reader.get_parent(i);
+		const int direction = reader.get_direction(i);
+		if(parent_index >= i || direction >= DirectionCount){
+			throw std::runtime_error("checkpoint: broken record");
+		}
+		const record_item* parent = records[parent_index];
+		const int zero = parent->state.zero;
+		const int target = geometry.neighbor(zero, direction);
+		if(target < 0){
+			throw std::runtime_error("checkpoint: broken record");
+		}
+		auto* item = new_record(resource);
+		const cell_type tile = parent->cells()[target];
+		item->prev = parent;
+		item->direction = static_cast<std::uint8_t>(direction);
+		item->index = static_cast<std::uint32_t>(i);
+		item->state = parent->state;
+		item->state.move(geometry, target, tile);
+		std::memcpy(item->cells(), parent->cells(), n * sizeof(cell_type));
+		item->cells()[zero] = tile;
+		item->cells()[target] = 0;
+		visited.insert(item);
+		records.push_back(item);
+	}
+}
+
+template<typename Geometry>
+void klotski_bfs_engine<Geometry>::save_checkpoint(klotski_checkpoint_writer& writer, const record_list& records, std::uint64_t expanded) const{
+	if(records.size() > UINT32_MAX){
+		throw std::runtime_error("checkpoint: too many positions");
+	}
+	for(std::uint64_t i=writer.get_records(); i<records.size(); ++i){
+		writer.append(records[i]->prev->index, records[i]->direction);
+	}
+	writer.commit(expanded);
+}
+
+template<typename Geometry>
+typename klotski_bfs_engine<Geometry>::record_item* klotski_bfs_engine<Geometry>::new_record(std::pmr::memory_resource* resource) const{
+	void* memory = resource->allocate(
+			sizeof(record_item) + geometry.get_size() * sizeof(cell_type), alignof(record_item));
+	return new (memory) record_item;
+}
+
+template<typename Geometry>
+void klotski_bfs_engine<Geometry>::build_route(const record_item& item, route_type& route) const{
+	const record_item* cur_item = &item;
+	route.clear();
+	bool last_horizontal = false;
+	bool is_first = true;
+	while(cur_item != nullptr){
+		const bool is_horizontal = cur_item->direction == Left || cur_item->direction == Right;
+		if(is_first || cur_item->prev == nullptr || is_horizontal != last_horizontal){
+			klotski_board::situation_type situation_cur(geometry.get_height(), std::vector<int>(geometry.get_width()));
+			const cell_type* cell = cur_item->cells();
+			for(auto& i: situation_cur){
+				for(int& j: i){
+					j = *cell++;
+				}
+			}
+			route.push_front(std::move(situation_cur));
+			last_horizontal = is_horizontal;
+			is_first = false;
+		}
+		cur_item = cur_item->prev;
+	}
+}
+
+// Picks the fixed-size engine for the common board sizes and falls back to
+// the dynamic geometry for everything else.
+template<template<typename> class Engine, typename... Args>
+std::unique_ptr<klotski_search_engine> klotski_make_engine(int width, int height, Args&&... args){
+#define KLOTSKI_MAKE_FIXED_ENGINE(w, h) \
+	if(width == w && height == h){ \
+		return std::make_unique<Engine<klotski_fixed_geometry<w, h>>>(klotski_fixed_geometry<w, h>(), std::forward<Args>(args)...); \
+	}
+	KLOTSKI_FIXED_GEOMETRIES(KLOTSKI_MAKE_FIXED_ENGINE)
+#undef KLOTSKI_MAKE_FIXED_ENGINE
+	return std::make_unique<Engine<klotski_dynamic_geometry>>(klotski_dynamic_geometry(width, height), std::forward<Args>(args)...);
+}
+
+#endif
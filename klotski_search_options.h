@@ -0,0 +1,55 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#ifndef KLOTSKI_SEARCH_OPTIONS_H
+#define KLOTSKI_SEARCH_OPTIONS_H
+
+#include <cstddef>
+#include <string>
+
+enum klotski_engine_type{
+	BfsEngine,
+	IdaEngine,
+	BidirectionalEngine,
+	PortfolioEngine
+};
+
+struct klotski_search_options{
+	klotski_engine_type engine = BfsEngine;
+	// Store square boards under their transposition-canonical form.
+	bool use_symmetry = true;
+	// Drop moves that close a known duplicate sequence in depth-first
+	// searches.
+	bool use_move_pruning = true;
+	// Bytes of bit array for a bitstate visited set, 0 keeps the exact one.
+	// The search runs depth-first, so it needs little more than that.
+	std::size_t bitstate_size = 0;
+	// Bytes of transposition table for the IDA* engine, 0 for none.
+	std::size_t transposition_size = 0;
+	// Bytes of table for the positions near the goal, 0 for none. It is
+	// built once per board size and the searches stop on reaching it.
+	std::size_t perimeter_size = 0;
+	// Write the breadth-first search state to this file every
+	// checkpoint_interval seconds, and pick it up again from resume_path.
+	std::string checkpoint_path;
+	int checkpoint_interval = 60;
+	std::string resume_path;
+	// Read hardware counters around every phase of the search.
+	bool use_profiling = false;
+	// Milliseconds the portfolio engine waits for an answer once its
+	// engines start, 0 for no limit.
+	int portfolio_deadline = 0;
+};
+
+#endif
@@ -0,0 +1,57 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#ifndef KLOTSKI_SEARCH_STATS_H
+#define KLOTSKI_SEARCH_STATS_H
+
+#include "klotski_profiler.h"
+#include <cstdint>
+
+struct klotski_search_stats{
+	// Positions stored in the visited set.
+	std::uint64_t states = 0;
+	// Depth of the deepest layer reached.
+	int depth = 0;
+
+	// Bitstate mode: size and fill of the bit array, the chance that the
+	// next new position would have been omitted and the expected number of
+	// positions omitted so far.
+	std::uint64_t bitstate_bits = 0;
+	std::uint64_t bitstate_set_bits = 0;
+	double omission_probability = 0;
+	double expected_omissions = 0;
+
+	// Transposition table: entries it can hold, entries in use and lookups
+	// that found a bound.
+	std::uint64_t transposition_capacity = 0;
+	std::uint64_t transposition_entries = 0;
+	std::uint64_t transposition_hits = 0;
+
+	// Perimeter: moves it reaches back from the goal and positions it holds.
+	int perimeter_depth = 0;
+	std::uint64_t perimeter_entries = 0;
+
+	// Portfolio engine: the strategy that answered first, -1 for none, and
+	// how many strategies were raced.
+	int portfolio_winner = -1;
+	int portfolio_raced = 0;
+	// The deadline passed while engines were still searching, so no
+	// answer says nothing about the board.
+	bool is_deadline_passed = false;
+
+	// Hardware counters by phase when profiling, searches == 0 otherwise.
+	klotski_profile profile;
+};
+
+#endif
@@ -0,0 +1,484 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#include "klotski_simd.h"
+#include "klotski_geometry.h"
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KLOTSKI_SIMD_X86
+#endif
+
+namespace{
+	template<typename T>
+		int find_scalar(const T* cells, int n, T value) noexcept{
+			for(int i=0; i<n; ++i){
+				if(cells[i] == value){
+					return i;
+				}
+			}
+			return n;
+		}
+
+	template<typename T>
+		int mismatch_scalar(const T* cells, int n, int first) noexcept{
+			for(int i=0; i<n; ++i){
+				if(cells[i] != first + i){
+					return i;
+				}
+			}
+			return n;
+		}
+
+	template<typename T>
+		std::uint32_t manhattan_scalar(const T* cells, int n, int width, int first_pos) noexcept{
+			std::uint32_t sum = 0;
+			for(int i=0; i<n; ++i){
+				sum += klotski_detail::tile_distance(first_pos + i, cells[i], width);
+			}
+			return sum;
+		}
+
+	template<typename T>
+		void score_moves_scalar(const T* cells, int width, int zero, std::uint32_t heuristic,
+				const int* targets, int count, std::uint32_t* out) noexcept{
+			for(int i=0; i<count; ++i){
+				const int tile = cells[targets[i]];
+				out[i] = heuristic - klotski_detail::tile_distance(targets[i], tile, width)
+					+ klotski_detail::tile_distance(zero, tile, width);
+			}
+		}
+
+	// A sequence check on narrow cells can only be vectorized while the
+	// expected values fit the cell type.
+	template<typename T>
+		bool is_sequence_representable(int n, int first) noexcept{
+			return first >= 0
+				&& static_cast<long long>(first) + n <= static_cast<long long>(std::numeric_limits<T>::max()) + 1;
+		}
+
+#ifdef KLOTSKI_SIMD_X86
+	template<typename T>
+		__m128i sse2_set1(int value) noexcept{
+			if constexpr(sizeof(T) == 1){
+				return _mm_set1_epi8(static_cast<char>(value));
+			}else if constexpr(sizeof(T) == 2){
+				return _mm_set1_epi16(static_cast<short>(value));
+			}else{
+				return _mm_set1_epi32(value);
+			}
+		}
+
+	template<typename T>
+		__m128i sse2_cmpeq(__m128i a, __m128i b) noexcept{
+			if constexpr(sizeof(T) == 1){
+				return _mm_cmpeq_epi8(a, b);
+			}else if constexpr(sizeof(T) == 2){
+				return _mm_cmpeq_epi16(a, b);
+			}else{
+				return _mm_cmpeq_epi32(a, b);
+			}
+		}
+
+	template<typename T>
+		__m128i sse2_add(__m128i a, __m128i b) noexcept{
+			if constexpr(sizeof(T) == 1){
+				return _mm_add_epi8(a, b);
+			}else if constexpr(sizeof(T) == 2){
+				return _mm_add_epi16(a, b);
+			}else{
+				return _mm_add_epi32(a, b);
+			}
+		}
+
+	// Four cells widened to 32-bit lanes.
+	template<typename T>
+		__m128i sse2_widen(const T* cells) noexcept{
+			const __m128i zero = _mm_setzero_si128();
+			if constexpr(sizeof(T) == 1){
+				int packed;
+				std::memcpy(&packed, cells, sizeof(packed));
+				return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+			}else if constexpr(sizeof(T) == 2){
+				return _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(cells)), zero);
+			}else{
+				return _mm_loadu_si128(reinterpret_cast<const __m128i*>(cells));
+			}
+		}
+
+	template<typename T>
+		int find_sse2(const T* cells, int n, T value) noexcept{
+			constexpr int lanes = 16 / sizeof(T);
+			const __m128i needle = sse2_set1<T>(value);
+			int i = 0;
+			for(; i + lanes <= n; i += lanes){
+				const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cells + i));
+				const int mask = _mm_movemask_epi8(sse2_cmpeq<T>(block, needle));
+				if(mask != 0){
+					return i + __builtin_ctz(mask) / static_cast<int>(sizeof(T));
+				}
+			}
+			return i + find_scalar(cells + i, n - i, value);
+		}
+
+	template<typename T>
+		int mismatch_sse2(const T* cells, int n, int first) noexcept{
+			constexpr int lanes = 16 / sizeof(T);
+			if(!is_sequence_representable<T>(n, first)){
+				return mismatch_scalar(cells, n, first);
+			}
+			alignas(16) T start[lanes];
+			for(int j=0; j<lanes; ++j){
+				start[j] = static_cast<T>(first + j);
+			}
+			__m128i expected = _mm_load_si128(reinterpret_cast<const __m128i*>(start));
+			const __m128i step = sse2_set1<T>(lanes);
+			int i = 0;
+			for(; i + lanes <= n; i += lanes){
+				const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cells + i));
+				const int mask = _mm_movemask_epi8(sse2_cmpeq<T>(block, expected)) ^ 0xffff;
+				if(mask != 0){
+					return i + __builtin_ctz(mask) / static_cast<int>(sizeof(T));
+				}
+				expected = sse2_add<T>(expected, step);
+			}
+			return i + mismatch_scalar(cells + i, n - i, first + i);
+		}
+
+	// Goal row and column are recovered with a float reciprocal: for
+	// k = row * width + col, (k + 0.5) / width stays at least 0.5 / width
+	// away from the next integer, far more than the rounding error.
+	template<typename T>
+		std::uint32_t manhattan_sse2(const T* cells, int n, int width, int first_pos) noexcept{
+			const __m128 inv_width = _mm_set1_ps(1.0f / width);
+			const __m128 width_ps = _mm_set1_ps(static_cast<float>(width));
+			const __m128 half = _mm_set1_ps(0.5f);
+			const __m128 sign = _mm_set1_ps(-0.0f);
+			const __m128i one = _mm_set1_epi32(1);
+			__m128 pos = _mm_add_ps(_mm_set1_ps(static_cast<float>(first_pos)), _mm_setr_ps(0, 1, 2, 3));
+			const __m128 step = _mm_set1_ps(4.0f);
+			__m128 sum = _mm_setzero_ps();
+			int i = 0;
+			for(; i + 4 <= n; i += 4){
+				const __m128i tile = sse2_widen(cells + i);
+				const __m128 occupied = _mm_castsi128_ps(_mm_xor_si128(
+							_mm_cmpeq_epi32(tile, _mm_setzero_si128()), _mm_set1_epi32(-1)));
+				const __m128 goal = _mm_cvtepi32_ps(_mm_sub_epi32(tile, one));
+				const __m128 goal_y = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(_mm_add_ps(goal, half), inv_width)));
+				const __m128 goal_x = _mm_sub_ps(goal, _mm_mul_ps(goal_y, width_ps));
+				const __m128 pos_y = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(_mm_add_ps(pos, half), inv_width)));
+				const __m128 pos_x = _mm_sub_ps(pos, _mm_mul_ps(pos_y, width_ps));
+				const __m128 distance = _mm_add_ps(
+						_mm_andnot_ps(sign, _mm_sub_ps(pos_x, goal_x)),
+						_mm_andnot_ps(sign, _mm_sub_ps(pos_y, goal_y)));
+				sum = _mm_add_ps(sum, _mm_and_ps(distance, occupied));
+				pos = _mm_add_ps(pos, step);
+			}
+			alignas(16) float lanes[4];
+			_mm_store_ps(lanes, sum);
+			return static_cast<std::uint32_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3])
+				+ manhattan_scalar(cells + i, n - i, width, first_pos + i);
+		}
+
+	// Row and column of four cells, by the same float reciprocal.
+	inline void sse2_split(__m128 pos, __m128 inv_width, __m128 width_ps, __m128& x, __m128& y) noexcept{
+		y = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(_mm_add_ps(pos, _mm_set1_ps(0.5f)), inv_width)));
+		x = _mm_sub_ps(pos, _mm_mul_ps(y, width_ps));
+	}
+
+	// Four moves per pass: each lane takes the tile of one target, and the
+	// distance it gains on the blank's cell less the one it had on its own.
+	template<typename T>
+		void score_moves_sse2(const T* cells, int width, int zero, std::uint32_t heuristic,
+				const int* targets, int count, std::uint32_t* out) noexcept{
+			const __m128 inv_width = _mm_set1_ps(1.0f / width);
+			const __m128 width_ps = _mm_set1_ps(static_cast<float>(width));
+			const __m128 sign = _mm_set1_ps(-0.0f);
+			const __m128i base = _mm_set1_epi32(static_cast<int>(heuristic));
+			__m128 zero_x, zero_y;
+			sse2_split(_mm_set1_ps(static_cast<float>(zero)), inv_width, width_ps, zero_x, zero_y);
+			for(int i=0; i<count; i+=4){
+				// The blank's own cell pads the last pass; its lanes are dropped.
+				alignas(16) int target[4];
+				alignas(16) int tile[4];
+				for(int j=0; j<4; ++j){
+					target[j] = i + j < count? targets[i + j]: zero;
+					tile[j] = i + j < count? cells[target[j]]: 1;
+				}
+				const __m128 goal = _mm_cvtepi32_ps(_mm_sub_epi32(
+							_mm_load_si128(reinterpret_cast<const __m128i*>(tile)), _mm_set1_epi32(1)));
+				__m128 goal_x, goal_y, pos_x, pos_y;
+				sse2_split(goal, inv_width, width_ps, goal_x, goal_y);
+				sse2_split(_mm_cvtepi32_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(target))),
+						inv_width, width_ps, pos_x, pos_y);
+				const __m128 before = _mm_add_ps(
+						_mm_andnot_ps(sign, _mm_sub_ps(pos_x, goal_x)),
+						_mm_andnot_ps(sign, _mm_sub_ps(pos_y, goal_y)));
+				const __m128 after = _mm_add_ps(
+						_mm_andnot_ps(sign, _mm_sub_ps(zero_x, goal_x)),
+						_mm_andnot_ps(sign, _mm_sub_ps(zero_y, goal_y)));
+				alignas(16) std::uint32_t lanes[4];
+				_mm_store_si128(reinterpret_cast<__m128i*>(lanes),
+						_mm_add_epi32(base, _mm_cvttps_epi32(_mm_sub_ps(after, before))));
+				for(int j=0; j<4 && i + j<count; ++j){
+					out[i + j] = lanes[j];
+				}
+			}
+		}
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+	template<typename T>
+		__m256i avx2_set1(int value) noexcept{
+			if constexpr(sizeof(T) == 1){
+				return _mm256_set1_epi8(static_cast<char>(value));
+			}else if constexpr(sizeof(T) == 2){
+				return _mm256_set1_epi16(static_cast<short>(value));
+			}else{
+				return _mm256_set1_epi32(value);
+			}
+		}
+
+	template<typename T>
+		__m256i avx2_cmpeq(__m256i a, __m256i b) noexcept{
+			if constexpr(sizeof(T) == 1){
+				return _mm256_cmpeq_epi8(a, b);
+			}else if constexpr(sizeof(T) == 2){
+				return _mm256_cmpeq_epi16(a, b);
+			}else{
+				return _mm256_cmpeq_epi32(a, b);
+			}
+		}
+
+	template<typename T>
+		__m256i avx2_add(__m256i a, __m256i b) noexcept{
+			if constexpr(sizeof(T) == 1){
+				return _mm256_add_epi8(a, b);
+			}else if constexpr(sizeof(T) == 2){
+				return _mm256_add_epi16(a, b);
+			}else{
+				return _mm256_add_epi32(a, b);
+			}
+		}
+
+	// Eight cells widened to 32-bit lanes.
+	template<typename T>
+		__m256i avx2_widen(const T* cells) noexcept{
+			if constexpr(sizeof(T) == 1){
+				return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(cells)));
+			}else if constexpr(sizeof(T) == 2){
+				return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(cells)));
+			}else{
+				return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cells));
+			}
+		}
+
+	template<typename T>
+		int find_avx2(const T* cells, int n, T value) noexcept{
+			constexpr int lanes = 32 / sizeof(T);
+			const __m256i needle = avx2_set1<T>(value);
+			int i = 0;
+			for(; i + lanes <= n; i += lanes){
+				const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cells + i));
+				const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(avx2_cmpeq<T>(block, needle)));
+				if(mask != 0){
+					return i + __builtin_ctz(mask) / static_cast<int>(sizeof(T));
+				}
+			}
+			return i + find_scalar(cells + i, n - i, value);
+		}
+
+	template<typename T>
+		int mismatch_avx2(const T* cells, int n, int first) noexcept{
+			constexpr int lanes = 32 / sizeof(T);
+			if(!is_sequence_representable<T>(n, first)){
+				return mismatch_scalar(cells, n, first);
+			}
+			alignas(32) T start[lanes];
+			for(int j=0; j<lanes; ++j){
+				start[j] = static_cast<T>(first + j);
+			}
+			__m256i expected = _mm256_load_si256(reinterpret_cast<const __m256i*>(start));
+			const __m256i step = avx2_set1<T>(lanes);
+			int i = 0;
+			for(; i + lanes <= n; i += lanes){
+				const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cells + i));
+				const unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(avx2_cmpeq<T>(block, expected)));
+				if(mask != 0){
+					return i + __builtin_ctz(mask) / static_cast<int>(sizeof(T));
+				}
+				expected = avx2_add<T>(expected, step);
+			}
+			return i + mismatch_scalar(cells + i, n - i, first + i);
+		}
+
+	template<typename T>
+		std::uint32_t manhattan_avx2(const T* cells, int n, int width, int first_pos) noexcept{
+			const __m256 inv_width = _mm256_set1_ps(1.0f / width);
+			const __m256 width_ps = _mm256_set1_ps(static_cast<float>(width));
+			const __m256 half = _mm256_set1_ps(0.5f);
+			const __m256 sign = _mm256_set1_ps(-0.0f);
+			const __m256i one = _mm256_set1_epi32(1);
+			__m256 pos = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(first_pos)),
+					_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7));
+			const __m256 step = _mm256_set1_ps(8.0f);
+			__m256 sum = _mm256_setzero_ps();
+			int i = 0;
+			for(; i + 8 <= n; i += 8){
+				const __m256i tile = avx2_widen(cells + i);
+				const __m256 occupied = _mm256_castsi256_ps(_mm256_xor_si256(
+							_mm256_cmpeq_epi32(tile, _mm256_setzero_si256()), _mm256_set1_epi32(-1)));
+				const __m256 goal = _mm256_cvtepi32_ps(_mm256_sub_epi32(tile, one));
+				const __m256 goal_y = _mm256_round_ps(_mm256_mul_ps(_mm256_add_ps(goal, half), inv_width),
+						_MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+				const __m256 goal_x = _mm256_sub_ps(goal, _mm256_mul_ps(goal_y, width_ps));
+				const __m256 pos_y = _mm256_round_ps(_mm256_mul_ps(_mm256_add_ps(pos, half), inv_width),
+						_MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+				const __m256 pos_x = _mm256_sub_ps(pos, _mm256_mul_ps(pos_y, width_ps));
+				const __m256 distance = _mm256_add_ps(
+						_mm256_andnot_ps(sign, _mm256_sub_ps(pos_x, goal_x)),
+						_mm256_andnot_ps(sign, _mm256_sub_ps(pos_y, goal_y)));
+				sum = _mm256_add_ps(sum, _mm256_and_ps(distance, occupied));
+				pos = _mm256_add_ps(pos, step);
+			}
+			const __m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+			alignas(16) float lanes[4];
+			_mm_store_ps(lanes, sum4);
+			return static_cast<std::uint32_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3])
+				+ manhattan_scalar(cells + i, n - i, width, first_pos + i);
+		}
+#pragma GCC pop_options
+#endif
+
+	klotski_simd::isa_type detect_isa() noexcept{
+#ifdef KLOTSKI_SIMD_X86
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx2")){
+			return klotski_simd::AVX2;
+		}
+		if(__builtin_cpu_supports("sse2")){
+			return klotski_simd::SSE2;
+		}
+#endif
+		return klotski_simd::Scalar;
+	}
+
+	klotski_simd::isa_type current_isa() noexcept{
+		static const klotski_simd::isa_type isa = detect_isa();
+		return isa;
+	}
+
+	template<typename T>
+		int find_dispatch(const T* cells, int n, T value) noexcept{
+#ifdef KLOTSKI_SIMD_X86
+			switch(current_isa()){
+				case klotski_simd::AVX2: return find_avx2(cells, n, value);
+				case klotski_simd::SSE2: return find_sse2(cells, n, value);
+				default: break;
+			}
+#endif
+			return find_scalar(cells, n, value);
+		}
+
+	template<typename T>
+		int mismatch_dispatch(const T* cells, int n, int first) noexcept{
+#ifdef KLOTSKI_SIMD_X86
+			switch(current_isa()){
+				case klotski_simd::AVX2: return mismatch_avx2(cells, n, first);
+				case klotski_simd::SSE2: return mismatch_sse2(cells, n, first);
+				default: break;
+			}
+#endif
+			return mismatch_scalar(cells, n, first);
+		}
+
+	template<typename T>
+		std::uint32_t manhattan_dispatch(const T* cells, int n, int width, int first_pos) noexcept{
+#ifdef KLOTSKI_SIMD_X86
+			switch(current_isa()){
+				case klotski_simd::AVX2: return manhattan_avx2(cells, n, width, first_pos);
+				case klotski_simd::SSE2: return manhattan_sse2(cells, n, width, first_pos);
+				default: break;
+			}
+#endif
+			return manhattan_scalar(cells, n, width, first_pos);
+		}
+
+	// A position has at most four moves, one SSE2 pass; AVX2 lanes would
+	// stay half empty.
+	template<typename T>
+		void score_moves_dispatch(const T* cells, int width, int zero, std::uint32_t heuristic,
+				const int* targets, int count, std::uint32_t* out) noexcept{
+#ifdef KLOTSKI_SIMD_X86
+			if(current_isa() != klotski_simd::Scalar){
+				score_moves_sse2(cells, width, zero, heuristic, targets, count, out);
+				return;
+			}
+#endif
+			score_moves_scalar(cells, width, zero, heuristic, targets, count, out);
+		}
+}
+
+klotski_simd::isa_type klotski_simd::get_isa() noexcept{
+	return current_isa();
+}
+
+int klotski_simd::find(const std::uint8_t* cells, int n, std::uint8_t value) noexcept{
+	return find_dispatch(cells, n, value);
+}
+
+int klotski_simd::find(const std::uint16_t* cells, int n, std::uint16_t value) noexcept{
+	return find_dispatch(cells, n, value);
+}
+
+int klotski_simd::find(const int* cells, int n, int value) noexcept{
+	return find_dispatch(cells, n, value);
+}
+
+int klotski_simd::mismatch_sequence(const std::uint8_t* cells, int n, int first) noexcept{
+	return mismatch_dispatch(cells, n, first);
+}
+
+int klotski_simd::mismatch_sequence(const std::uint16_t* cells, int n, int first) noexcept{
+	return mismatch_dispatch(cells, n, first);
+}
+
+int klotski_simd::mismatch_sequence(const int* cells, int n, int first) noexcept{
+	return mismatch_dispatch(cells, n, first);
+}
+
+std::uint32_t klotski_simd::manhattan(const std::uint8_t* cells, int n, int width, int first_pos) noexcept{
+	return manhattan_dispatch(cells, n, width, first_pos);
+}
+
+std::uint32_t klotski_simd::manhattan(const std::uint16_t* cells, int n, int width, int first_pos) noexcept{
+	return manhattan_dispatch(cells, n, width, first_pos);
+}
+
+std::uint32_t klotski_simd::manhattan(const int* cells, int n, int width, int first_pos) noexcept{
+	return manhattan_dispatch(cells, n, width, first_pos);
+}
+
+void klotski_simd::score_moves(const std::uint8_t* cells, int width, int zero, std::uint32_t heuristic,
+		const int* targets, int count, std::uint32_t* out) noexcept{
+	score_moves_dispatch(cells, width, zero, heuristic, targets, count, out);
+}
+
+void klotski_simd::score_moves(const std::uint16_t* cells, int width, int zero, std::uint32_t heuristic,
+		const int* targets, int count, std::uint32_t* out) noexcept{
+	score_moves_dispatch(cells, width, zero, heuristic, targets, count, out);
+}
@@ -0,0 +1,59 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#ifndef KLOTSKI_SIMD_H
+#define KLOTSKI_SIMD_H
+
+#include <cstdint>
+
+// Bulk board kernels over contiguous tile arrays. The implementation is
+// picked once from what the CPU supports; every kernel has a scalar
+// fallback that gives the same results.
+class klotski_simd
+{
+	public:
+		enum isa_type{
+			Scalar,
+			SSE2,
+			AVX2
+		};
+
+		static isa_type get_isa() noexcept;
+
+		// Index of the first cell equal to value, or n.
+		static int find(const std::uint8_t* cells, int n, std::uint8_t value) noexcept;
+		static int find(const std::uint16_t* cells, int n, std::uint16_t value) noexcept;
+		static int find(const int* cells, int n, int value) noexcept;
+
+		// Index of the first cell that is not first + index, or n.
+		static int mismatch_sequence(const std::uint8_t* cells, int n, int first) noexcept;
+		static int mismatch_sequence(const std::uint16_t* cells, int n, int first) noexcept;
+		static int mismatch_sequence(const int* cells, int n, int first) noexcept;
+
+		// Sum of the Manhattan distances of the tiles from their goal cells,
+		// cells[0] being board cell first_pos.
+		static std::uint32_t manhattan(const std::uint8_t* cells, int n, int width, int first_pos = 0) noexcept;
+		static std::uint32_t manhattan(const std::uint16_t* cells, int n, int width, int first_pos = 0) noexcept;
+		static std::uint32_t manhattan(const int* cells, int n, int width, int first_pos = 0) noexcept;
+
+		// Manhattan sums after each of count moves out of one position,
+		// scored four to a vector pass: the tile on targets[i] slides into the
+		// blank at zero, heuristic being the position's own sum.
+		static void score_moves(const std::uint8_t* cells, int width, int zero, std::uint32_t heuristic,
+				const int* targets, int count, std::uint32_t* out) noexcept;
+		static void score_moves(const std::uint16_t* cells, int width, int zero, std::uint32_t heuristic,
+				const int* targets, int count, std::uint32_t* out) noexcept;
+};
+
+#endif
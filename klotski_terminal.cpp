@@ -0,0 +1,112 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#include "klotski_terminal.h"
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+#include <sstream>
+#include <sys/ioctl.h>
+
+klotski_terminal::klotski_terminal(int fd):
+	fd(fd),
+	is_tty(::isatty(fd) == 1){}
+
+bool klotski_terminal::is_fit(int dx, int dy, bool display_board) const noexcept{
+	struct winsize size;
+	if(::ioctl(fd, TIOCGWINSZ, &size) != 0){
+		return false;
+	}
+	const int cell_width = klotski_board::get_cell_width(dx, dy) + 1;
+	const int columns = display_board? cell_width * (dx + 1) + 1: cell_width * dx;
+	const int lines = display_board? 2 + 2 * dy: dy;
+	// One more line for the prompt.
+	return columns <= size.ws_col && lines + 1 <= size.ws_row;
+}
+
+void klotski_terminal::draw(const klotski_board& board, bool display_board){
+	const auto& situation = board.get_situation();
+	const int dx = board.get_dx();
+	const int dy = board.get_dy();
+	if(!is_tty || !is_fit(dx, dy, display_board)){
+		invalidate();
+		board.print_board(display_board);
+		return;
+	}
+	if(shown.empty() || is_board_shown != display_board
+			|| shown.size() != situation.size() || shown[0].size() != situation[0].size()){
+		draw_full(board, display_board);
+		return;
+	}
+	frame.clear();
+	for(int y=0; y<dy; ++y){
+		for(int x=0; x<dx; ++x){
+			if(shown[y][x] != situation[y][x]){
+				put_cell(x, y, situation[y][x]);
+				shown[y][x] = situation[y][x];
+			}
+		}
+	}
+	// Park the cursor below the board and drop the old prompt and input.
+	frame += "\x1b[" + std::to_string(frame_lines + 1) + ";1H\x1b[J";
+	write_frame();
+}
+
+void klotski_terminal::draw_full(const klotski_board& board, bool display_board){
+	std::stringstream output_stream;
+	board.print_board(display_board, output_stream);
+	frame = "\x1b[H\x1b[J" + output_stream.str();
+	write_frame();
+	shown = board.get_situation();
+	is_board_shown = display_board;
+	space_n = klotski_board::get_cell_width(board.get_dx(), board.get_dy());
+	frame_lines = display_board? 2 + 2 * board.get_dy(): board.get_dy();
+}
+
+void klotski_terminal::put_cell(int x, int y, int n){
+	// Same places and padding as print_board: with the board drawn the
+	// numbers follow the row label and are left aligned, and the blank
+	// is left empty; without it they are right aligned.
+	int line;
+	int column;
+	std::string text = n == 0 && is_board_shown? std::string(): std::to_string(n);
+	text.resize(std::max<std::size_t>(text.size(), space_n), ' ');
+	if(is_board_shown){
+		line = 3 + 2 * y;
+		column = 1 + (space_n + 1) * (x + 1);
+	}else{
+		std::rotate(text.begin(), text.begin() + text.find_last_not_of(' ') + 1, text.end());
+		line = 1 + y;
+		column = 1 + (space_n + 1) * x;
+	}
+	frame += "\x1b[" + std::to_string(line) + ";" + std::to_string(column) + "H" + text;
+}
+
+void klotski_terminal::write_frame(){
+	// The prompt and earlier output go through std::cout.
+	std::cout.flush();
+	const char* data = frame.data();
+	std::size_t size = frame.size();
+	while(size != 0){
+		ssize_t n = ::write(fd, data, size);
+		if(n < 0){
+			if(errno == EINTR){
+				continue;
+			}
+			break;
+		}
+		data += n;
+		size -= n;
+	}
+}
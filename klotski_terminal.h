@@ -0,0 +1,57 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#ifndef KLOTSKI_TERMINAL_H
+#define KLOTSKI_TERMINAL_H
+
+#include "klotski_board.h"
+#include <string>
+#include <unistd.h>
+
+// Draws the board of an interactive session. On a terminal the board is
+// kept at the top of the screen and every draw after the first rewrites
+// only the cells that changed since the last one, using ANSI cursor
+// positioning and a single write. Anything else, or a board that does not
+// fit the window, gets the full print_board output each time.
+class klotski_terminal
+{
+	public:
+		explicit klotski_terminal(int fd = STDOUT_FILENO);
+
+		void draw(const klotski_board& board, bool display_board);
+		// Other output moved the screen, so the next draw starts over.
+		void invalidate() noexcept{
+			shown.clear();
+		}
+
+		bool is_terminal() const noexcept{
+			return is_tty;
+		}
+
+	private:
+		bool is_fit(int dx, int dy, bool display_board) const noexcept;
+		void draw_full(const klotski_board& board, bool display_board);
+		void put_cell(int x, int y, int n);
+		void write_frame();
+
+		int fd;
+		bool is_tty;
+		klotski_board::situation_type shown;
+		bool is_board_shown = false;
+		int space_n = 0;
+		int frame_lines = 0;
+		std::string frame;
+};
+
+#endif
@@ -0,0 +1,80 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#include "klotski_transposition.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+klotski_transposition::klotski_transposition(std::size_t size, std::pmr::memory_resource* resource):
+	buckets(size / sizeof(bucket)),
+	size(size / sizeof(bucket) * sizeof(bucket)),
+	resource(resource){
+		if(buckets == 0){
+			throw std::invalid_argument("transposition table size too small");
+		}
+		table = static_cast<bucket*>(resource->allocate(this->size, alignof(bucket)));
+		std::memset(static_cast<void*>(table), 0, this->size);
+	}
+
+klotski_transposition::~klotski_transposition(){
+	resource->deallocate(table, size, alignof(bucket));
+}
+
+std::uint32_t klotski_transposition::probe(std::uint64_t key) noexcept{
+	const bucket& b = table[(static_cast<unsigned __int128>(key) * buckets) >> 64];
+	for(const entry& slot: b.slots){
+		if(slot.is_used && slot.key == key){
+			++hits;
+			return slot.bound;
+		}
+	}
+	return 0;
+}
+
+void klotski_transposition::store(std::uint64_t key, std::uint32_t bound, std::uint32_t draft) noexcept{
+	bucket& b = table[(static_cast<unsigned __int128>(key) * buckets) >> 64];
+	const auto clamp = [](std::uint32_t n){
+		return static_cast<std::uint16_t>(std::min<std::uint32_t>(n, 0xffff));
+	};
+	entry* victim = nullptr;
+	for(entry& slot: b.slots){
+		if(slot.is_used && slot.key == key){
+			// Bounds only ever grow, and the fresh age keeps it in place.
+			slot.bound = std::max(slot.bound, clamp(bound));
+			slot.draft = std::max(slot.draft, clamp(draft));
+			slot.age = age;
+			return;
+		}
+		if(!slot.is_used){
+			if(victim == nullptr || victim->is_used){
+				victim = &slot;
+			}
+			continue;
+		}
+		if(victim == nullptr || (victim->is_used && (
+						static_cast<std::uint8_t>(age - slot.age) > static_cast<std::uint8_t>(age - victim->age)
+						|| (slot.age == victim->age && slot.draft < victim->draft)))){
+			victim = &slot;
+		}
+	}
+	if(!victim->is_used){
+		++entries;
+	}
+	victim->key = key;
+	victim->bound = clamp(bound);
+	victim->draft = clamp(draft);
+	victim->age = age;
+	victim->is_used = true;
+}
@@ -0,0 +1,82 @@
+/* Copyright [2020] [iTruth]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.  */
+
+#ifndef KLOTSKI_TRANSPOSITION_H
+#define KLOTSKI_TRANSPOSITION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+// Fixed-size table of lower bounds on the distance to the goal, for
+// depth-first searches that meet the same position many times. Entries
+// sit in buckets of one cache line; a full bucket gives up the entry left
+// from the oldest iteration, and among those the one whose bound took the
+// least search to prove.
+class klotski_transposition
+{
+	public:
+		klotski_transposition(std::size_t size, std::pmr::memory_resource* resource);
+		klotski_transposition(const klotski_transposition&) = delete;
+		klotski_transposition& operator=(const klotski_transposition&) = delete;
+
+		// Known lower bound for key, 0 if there is none.
+		std::uint32_t probe(std::uint64_t key) noexcept;
+		// Records that key is at least bound away from the goal, proved by a
+		// search draft moves deep.
+		void store(std::uint64_t key, std::uint32_t bound, std::uint32_t draft) noexcept;
+		// Starts a new iteration; its entries outrank the older ones.
+		void next_age() noexcept{
+			++age;
+		}
+
+		std::uint64_t get_capacity() const noexcept{
+			return static_cast<std::uint64_t>(buckets) * bucket_entries;
+		}
+
+		std::uint64_t get_entries() const noexcept{
+			return entries;
+		}
+
+		std::uint64_t get_hits() const noexcept{
+			return hits;
+		}
+
+		~klotski_transposition();
+
+	private:
+		struct entry{
+			std::uint64_t key;
+			std::uint16_t bound;
+			std::uint16_t draft;
+			std::uint8_t age;
+			bool is_used;
+		};
+
+		static constexpr int bucket_entries = 4;
+
+		struct alignas(64) bucket{
+			entry slots[bucket_entries];
+		};
+
+		bucket* table;
+		std::size_t buckets;
+		std::size_t size;
+		std::pmr::memory_resource* resource;
+		std::uint8_t age = 0;
+		std::uint64_t entries = 0;
+		std::uint64_t hits = 0;
+};
+
+#endif